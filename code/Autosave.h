@@ -0,0 +1,152 @@
+// Autosave journal
+//
+// Edits since the last load or save are kept in AUTOSAVE_FILE so a power cut
+// loses at most the last AUTOSAVE_INTERVAL_MS of panel moves. The file is
+// made AUTOSAVE_FILE_SIZE bytes of 0xFF once and only ever written in place:
+//
+//   header   "AJ", uint8 state version, uint8 generation, uint16 patch number,
+//            uint8 bank, uint8 spare
+//   records  uint8 PF_ field, uint8 generation, int16 value
+//
+// Once a second the fields that differ from the last journalled copy are
+// appended as records, one write and flush, skipped while loop() is
+// shedding. Loading or saving a patch, or reaching the end of the file,
+// compacts it: the whole state goes in as records of the next generation
+// from the start, then the header. Every write ends with an AUTOSAVE_END
+// record, which the next write goes over, so replay stops there and never
+// reaches records left from an older pass that happen to carry the same
+// generation once it has wrapped. Nothing has to be erased.
+//
+// At boot the journal's patch is loaded and the records replayed over it,
+// at most AUTOSAVE_FILE_SIZE bytes to read. The sequences aren't journalled.
+
+#define AUTOSAVE_FILE "/AUTOSAVE/LIVE.JNL"  // In a directory so the patch list skips it
+#define AUTOSAVE_FILE_SIZE 16384
+#define AUTOSAVE_INTERVAL_MS 1000
+#define AUTOSAVE_HEADER_SIZE 8
+#define AUTOSAVE_MAX_RECORDS 32  // Per write, the rest wait for the next one
+
+// Defined in Source.ino
+void patchSnapshot(PatchState &to, const PatchState &from);
+boolean patchEdited();
+void applyPatchState();
+
+struct AutosaveRecord {
+  uint8_t field;
+  uint8_t gen;
+  int16_t value;
+};
+static_assert(sizeof(AutosaveRecord) == 4, "AutosaveRecord is written as 4 bytes");
+static_assert(AUTOSAVE_HEADER_SIZE + (PATCH_FIELD_COUNT + 1) * sizeof(AutosaveRecord) <= 512,
+              "A compacted journal fits in one SD block");
+
+const AutosaveRecord AUTOSAVE_END = { 0xFF, 0xFF, -1 };  // As blank file
+
+File autosaveFile;
+PatchState autosaveShadow;  // As far as the journal has got
+uint32_t autosavePos = 0;
+uint8_t autosaveGen = 0;
+boolean autosaveCompactDue = false;
+elapsedMillis autosaveTimer;
+
+// Journal from the next write on starts again from the current patch
+void autosaveRebase() {
+  autosaveCompactDue = true;
+}
+
+void autosaveCompact() {
+  AutosaveRecord records[PATCH_FIELD_COUNT + 1];
+  autosaveGen = autosaveGen >= 0xFE ? 0 : autosaveGen + 1;  // 0xFF is blank file
+  for (uint8_t i = 0; i < PATCH_FIELD_COUNT; i++) {
+    records[i] = { i, autosaveGen, (int16_t)patchFieldGet(patch, i) };
+  }
+  records[PATCH_FIELD_COUNT] = AUTOSAVE_END;
+  uint8_t header[AUTOSAVE_HEADER_SIZE] = { 'A', 'J', PATCH_STATE_VERSION, autosaveGen,
+                                           (uint8_t)(patchNo & 0xFF), (uint8_t)(patchNo >> 8), patchBank, 0 };
+  autosaveFile.seek(AUTOSAVE_HEADER_SIZE);
+  autosaveFile.write((const uint8_t *)records, sizeof(records));
+  autosaveFile.seek(0);
+  autosaveFile.write(header, sizeof(header));
+  autosaveFile.flush();
+  autosavePos = AUTOSAVE_HEADER_SIZE + PATCH_FIELD_COUNT * sizeof(AutosaveRecord);
+  patchSnapshot(autosaveShadow, patch);
+  autosaveCompactDue = false;
+}
+
+void checkAutosave() {
+  if (!autosaveFile || autosaveTimer < AUTOSAVE_INTERVAL_MS) return;
+  if (shedLevel > 0 || morphActive || patchComparing) return;
+  autosaveTimer = 0;
+  if (autosaveCompactDue) {
+    autosaveCompact();
+    return;
+  }
+
+  AutosaveRecord records[AUTOSAVE_MAX_RECORDS + 1];
+  uint8_t count = 0;
+  for (uint8_t i = 0; i < PATCH_FIELD_COUNT && count < AUTOSAVE_MAX_RECORDS; i++) {
+    int value = patchFieldGet(patch, i);
+    if (value == patchFieldGet(autosaveShadow, i)) continue;
+    records[count++] = { i, autosaveGen, (int16_t)value };
+  }
+  if (count == 0) return;
+  records[count] = AUTOSAVE_END;
+
+  if (autosavePos + (count + 1) * sizeof(AutosaveRecord) > AUTOSAVE_FILE_SIZE) {
+    autosaveCompact();
+    return;
+  }
+  autosaveFile.seek(autosavePos);
+  autosaveFile.write((const uint8_t *)records, (count + 1) * sizeof(AutosaveRecord));
+  autosaveFile.flush();
+  autosavePos += count * sizeof(AutosaveRecord);
+  for (uint8_t i = 0; i < count; i++) patchFieldSet(autosaveShadow, records[i].field, records[i].value);
+}
+
+// Opens or makes the journal. Returns the patch it was journalling, 0 if
+// there is nothing to restore.
+int autosaveSetup() {
+  SD.mkdir("/AUTOSAVE");
+  autosaveFile = SD.open(AUTOSAVE_FILE, FILE_WRITE);
+  if (!autosaveFile) return 0;
+  if (autosaveFile.size() < AUTOSAVE_FILE_SIZE) {
+    uint8_t blank[512];
+    memset(blank, 0xFF, sizeof(blank));
+    autosaveFile.seek(0);
+    for (uint32_t i = 0; i < AUTOSAVE_FILE_SIZE; i += sizeof(blank)) autosaveFile.write(blank, sizeof(blank));
+    autosaveFile.flush();
+    autosaveCompactDue = true;
+    return 0;
+  }
+
+  uint8_t header[AUTOSAVE_HEADER_SIZE];
+  autosaveFile.seek(0);
+  autosaveFile.read(header, sizeof(header));
+  autosaveCompactDue = true;
+  if (header[0] != 'A' || header[1] != 'J' || header[2] > PATCH_STATE_VERSION || header[6] != patchBank) return 0;
+  autosaveGen = header[3];
+  return header[4] | header[5] << 8;
+}
+
+// Called with the journal's patch loaded, puts the edits back over it
+void autosaveRestore() {
+  AutosaveRecord records[128];
+  uint32_t pos = AUTOSAVE_HEADER_SIZE;
+  uint16_t replayed = 0;
+  autosaveFile.seek(pos);
+  while (pos < AUTOSAVE_FILE_SIZE) {
+    int n = autosaveFile.read((uint8_t *)records, sizeof(records)) / sizeof(AutosaveRecord);
+    if (n <= 0) break;
+    int i = 0;
+    while (i < n && records[i].gen == autosaveGen && records[i].field < PATCH_FIELD_COUNT) {
+      patchFieldSet(patch, records[i].field, records[i].value);
+      i++;
+    }
+    pos += i * sizeof(AutosaveRecord);
+    replayed += i;
+    if (i < n) break;
+  }
+  applyPatchState();
+  if (patchEdited()) showPatchPage("Restored", "edits");
+  Serial.println("Autosave replayed " + String(replayed) + " records");
+}
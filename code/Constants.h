@@ -1,28 +1,64 @@
 const char* VERSION = "V2.1";
 
-const float FILTERCUTOFF[128] = {20, 23, 26, 29, 32, 36, 40, 46, 53, 60, 69, 78, 87, 98, 109, 120, 132, 145, 157, 171, 186, 200, 215, 231, 247, 264, 282, 300, 319, 338, 357, 378, 399, 421, 444, 467, 491, 516, 541, 567, 594, 621, 650, 680, 710, 741, 774, 806, 841, 876, 912, 949, 987, 1027, 1068, 1110, 1152, 1196, 1242, 1290, 1338, 1388, 1439, 1491, 1547, 1603, 1661, 1723, 1783, 1843, 1915, 1975, 2047, 2119, 2191, 2263, 2347, 2419, 2503, 2587, 2683, 2767, 2863, 2959, 3055, 3163, 3259, 3367, 3487, 3595, 3715, 3835, 3967, 4099, 4231, 4363, 4507, 4663, 4807, 4963, 5131, 5287, 5467, 5635, 5815, 6007, 6199, 6403, 6607, 6823, 7039, 7267, 7495, 7735, 7987, 8239, 8503, 8779, 9055, 9343, 9643, 9955, 10267, 10603, 10939, 11287, 11647, 12000};
-const float FILTERFREQS[128] = {20, 23, 26, 29, 32, 36, 40, 46, 53, 60, 69, 78, 87, 98, 109, 120, 132, 145, 157, 171, 186, 200, 215, 231, 247, 264, 282, 300, 319, 338, 357, 378, 399, 421, 444, 467, 491, 516, 541, 567, 594, 621, 650, 680, 710, 741, 774, 806, 841, 876, 912, 949, 987, 1027, 1068, 1110, 1152, 1196, 1242, 1290, 1338, 1388, 1439, 1491, 1547, 1603, 1661, 1723, 1783, 1843, 1915, 1975, 2047, 2119, 2191, 2263, 2347, 2419, 2503, 2587, 2683, 2767, 2863, 2959, 3055, 3163, 3259, 3367, 3487, 3595, 3715, 3835, 3967, 4099, 4231, 4363, 4507, 4663, 4807, 4963, 5131, 5287, 5467, 5635, 5815, 6007, 6199, 6403, 6607, 6823, 7039, 7267, 7495, 7735, 7987, 8239, 8503, 8779, 9055, 9343, 9643, 9955, 10267, 10603, 10939, 11287, 11647, 12000};
-const float GLIDE[128] = {12, 32, 54, 76, 98, 120, 142, 164, 186, 208, 230, 252, 274, 296, 318, 340, 362, 384, 406, 428, 450, 472, 494, 516, 538, 560, 582, 604, 626, 648, 670, 692, 714, 736, 758, 780, 802, 824, 846, 868, 890, 912, 934, 956, 978, 1000, 1022, 1044, 1066, 1088, 1110, 1132, 1154, 1176, 1198, 1220, 1242, 1264, 1286, 1308, 1324, 1342, 1360, 1378, 1396, 1414, 1432, 1450, 1468, 1486, 1510, 1528, 1546, 1564, 1582, 1600, 1618, 1636, 1654, 1672, 1690, 1708, 1726, 1744, 1762, 1780, 1798, 1816, 1834, 1852, 1870, 1888, 1896, 1914, 1932, 1950, 1968, 1986, 2004, 2022, 2040, 2058, 2076, 2094, 2112, 2130, 2148, 2166, 2184, 2202, 2220, 2238, 2256, 2274, 2292, 2310, 2328, 2346, 2364, 2382, 2400, 2420, 2440, 2460, 2480, 2500, 2500};
-const float ENVTIMES[128] = {1, 2, 4, 6, 9, 14, 20, 26, 33, 41, 49, 58, 67, 78, 89, 99, 111, 124, 136, 150, 164, 178, 192, 209, 224, 241, 258, 276, 295, 314, 333, 353, 374, 395, 418, 440, 464, 489, 513, 539, 565, 592, 621, 650, 680, 710, 742, 774, 808, 843, 878, 915, 952, 991, 1031, 1073, 1114, 1158, 1202, 1250, 1297, 1346, 1396, 1448, 1502, 1558, 1614, 1676, 1735, 1794, 1864, 1923, 1994, 2065, 2136, 2207, 2289, 2360, 2443, 2525, 2620, 2702, 2797, 2891, 2985, 3092, 3186, 3292, 3410, 3516, 3634, 3752, 3882, 4012, 4142, 4272, 4413, 4567, 4708, 4862, 5027, 5180, 5357, 5522, 5699, 5888, 6077, 6278, 6478, 6691, 6903, 7127, 7351, 7587, 7835, 8083, 8343, 8614, 8885, 9169, 9464, 9770, 10077, 10408, 10738, 11080, 11434, 11700};
-const float LFOTEMPO[128] = {0.050, 0.050, 0.055, 0.055, 0.060, 0.064, 0.064, 0.069, 0.072, 0.077, 0.077, 0.081, 0.080, 0.087, 0.087, 0.092, 0.100, 0.100, 0.100, 0.104, 0.109, 0.115, 0.115, 0.122, 0.130, 0.130, 0.139, 0.149, 0.160, 0.160, 0.172, 0.185, 0.196, 0.20, 0.20, 0.21, 0.22, 0.24, 0.24, 0.26, 0.27, 0.29, 0.29, 0.31, 0.34, 0.37, 0.37, 0.39, 0.4, 0.40, 0.42, 0.45, 0.47, 0.47, 0.50, 0.53, 0.57, 0.57, 0.6, 0.62, 0.62, 0.65, 0.69, 0.74, 0.74, 0.80, 0.80, 0.86, 0.86, 0.94, 1.00, 1.00, 1.10, 1.12, 1.14, 1.14, 1.17, 1.20, 1.30, 1.40, 1.50, 1.50, 1.60, 1.60, 1.7, 1.8, 1.9, 2.0, 2.2, 2.2, 2.4, 2.6, 2.8, 3.00, 3.00, 3.1, 3.2, 3.2, 3.4, 3.80, 3.80, 4.10, 4.40, 4.70, 4.70, 5.00, 5.40, 5.80, 6.00, 6.00, 6.20, 6.40, 6.40, 6.80, 6.80, 7.30, 7.60, 8.00, 8.60, 9.30, 9.90, 10.60, 10.60, 11.50, 12.20, 12.80, 12.80, 12.80};
-const float LFOTEMPOINV[128] = {12.80, 12.80, 12.80, 0.055, 0.060, 0.064, 0.064, 0.069, 0.072, 0.077, 0.077, 0.081, 0.080, 0.087, 0.087, 0.092, 0.100, 0.100, 0.100, 0.104, 0.109, 0.115, 0.115, 0.122, 0.130, 0.130, 0.139, 0.149, 0.160, 0.160, 0.172, 0.185, 0.196, 0.20, 0.20, 0.21, 0.22, 0.24, 0.24, 0.26, 0.27, 0.29, 0.29, 0.31, 0.34, 0.37, 0.37, 0.39, 0.4, 0.40, 0.42, 0.45, 0.47, 0.47, 0.50, 0.53, 0.57, 0.57, 0.6, 0.62, 0.62, 0.65, 0.69, 0.74, 0.74, 0.80, 0.80, 0.86, 0.86, 0.94, 1.00, 1.00, 1.10, 1.12, 1.14, 1.14, 1.17, 1.20, 1.30, 1.40, 1.50, 1.50, 1.60, 1.60, 1.7, 1.8, 1.9, 2.0, 2.2, 2.2, 2.4, 2.6, 2.8, 3.00, 3.00, 3.1, 3.2, 3.2, 3.4, 3.80, 3.80, 4.10, 4.40, 4.70, 4.70, 5.00, 5.40, 5.80, 6.00, 6.00, 6.20, 6.40, 6.40, 6.80, 6.80, 7.30, 7.60, 8.00, 8.60, 9.30, 9.90, 10.60, 10.60, 11.50, 12.20, 12.80, 12.80, 12.80};
-const String LFOTEMPOSTR[128] = {"1/32", "1/32", "1/32", "1/32", "1/32", "1/32", "1/32", "1/32", "3/64", "3/64", "3/64", "3/64", "3/64", "3/64", "3/64", "3/64", "1/16", "1/16", "1/16", "1/16", "1/16", "1/16", "1/16", "1/16", "3/32", "3/32", "3/32", "3/32", "3/32", "3/32", "3/32", "3/32", "1/8", "1/8", "1/8", "1/8", "1/8", "1/8", "1/8", "1/8", "3/16", "3/16", "3/16", "3/16", "3/16", "3/16", "3/16", "3/16", "1/4", "1/4", "1/4", "1/4", "1/4", "1/4", "1/4", "1/4", "3/8", "3/8", "3/8", "3/8", "3/8", "3/8", "3/8", "3/8", "1/2", "1/2", "1/2", "1/2", "1/2", "1/2", "1/2", "1/2", "3/4", "3/4", "3/4", "3/4", "3/4", "3/4", "3/4", "3/4", "1", "1", "1", "1", "1", "1", "1", "1", "3/2", "3/2", "3/2", "3/2", "3/2", "3/2", "3/2", "3/2", "2", "2", "2", "2", "2", "2", "2", "2", "3", "3", "3", "3", "3", "3", "3", "3", "4", "4", "4", "4", "4", "4", "4", "4", "6", "6", "6", "6", "6", "6", "6", "6"};
-const float PITCH[128] = { -24, -24, -24, -24, -24, -12, -12, -12, -12, -12, -11, -11, -11, -11, -11, -10, -10, -10, -10, -9, -9, -9, -9, -9, -8, -8, -8, -8, -8, -7, -7, -7, -7, -7, -6, -6, -6, -6, -5, -5, -5, -5, -5, -4, -4, -4, -4, -4, -3, -3, -3, -3, -3, -2, -2, -2, -2, -1, -1, -1, -1, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 7, 8, 8, 8, 8, 8, 9, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 12, 12, 24, 24, 24, 24, 24};
-const float PITCH_DETUNE[128] = {-5, -5, -5, -5, -5, -5, -5, -5, -5, -5, -5, -5, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -3, -3, -3, -3, -3, -3, -3, -3, -3, -3, -3, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -2, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5};
-const float INTERVAL[128] = { 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15, 16, 16, 16, 16, 17, 17, 17, 17, 18, 18, 18, 18, 19, 19, 19, 19, 20, 20, 20, 20, 21, 21, 21, 21, 22, 22, 22, 22, 23, 23, 23, 23, 24, 24, 24, 24};
-const float INTERVALSEMI[128] = { 0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 6, 6, 6, 6, 7, 7, 7, 7, 8, 8, 8, 8, 9, 9, 9, 9, 10, 10, 10, 10, 11, 11, 11, 11, 12, 12, 12, 12, 13, 13, 13, 13, 14, 14, 14, 14, 15, 15, 15, 15, 16, 16, 16, 16, 17, 17, 17, 17, 18, 18, 18, 18, 19, 19, 19, 19, 20, 20, 20, 20, 21, 21, 21, 21, 22, 22, 22, 22, 23, 23, 23, 23, 24, 24, 24, 24};
-const float PITCHBEND[128] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7};
-const float PITCHBEND_REVERSE[128] = {7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 7, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 6, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 5, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 4, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 3, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 2, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
-const float ROTARY[128] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127};
-const float LINEAR[128] = {0, 0.008, 0.016, 0.024, 0.031, 0.039, 0.047, 0.055, 0.063, 0.071, 0.079, 0.087, 0.094, 0.102, 0.11, 0.118, 0.126, 0.134, 0.142, 0.15, 0.157, 0.165, 0.173, 0.181, 0.189, 0.197, 0.205, 0.213, 0.22, 0.228, 0.236, 0.244, 0.252, 0.26, 0.268, 0.276, 0.283, 0.291, 0.299, 0.307, 0.315, 0.323, 0.331, 0.339, 0.346, 0.354, 0.362, 0.37, 0.378, 0.386, 0.394, 0.402, 0.409, 0.417, 0.425, 0.433, 0.441, 0.449, 0.457, 0.465, 0.472, 0.48, 0.488, 0.496, 0.504, 0.512, 0.52, 0.528, 0.535, 0.543, 0.551, 0.559, 0.567, 0.575, 0.583, 0.591, 0.598, 0.606, 0.614, 0.622, 0.63, 0.638, 0.646, 0.654, 0.661, 0.669, 0.677, 0.685, 0.693, 0.701, 0.709, 0.717, 0.724, 0.732, 0.74, 0.748, 0.756, 0.764, 0.772, 0.78, 0.787, 0.795, 0.803, 0.811, 0.819, 0.827, 0.835, 0.843, 0.85, 0.858, 0.866, 0.874, 0.882, 0.89, 0.898, 0.906, 0.913, 0.921, 0.929, 0.937, 0.945, 0.953, 0.961, 0.969, 0.976, 0.984, 0.992, 1.00};
-const float LINEARCENTREZERO[128] = { -1, -0.98, -0.97, -0.95, -0.93, -0.92, -0.9, -0.88, -0.87, -0.85, -0.83, -0.82, -0.8, -0.78, -0.77, -0.75, -0.73, -0.72, -0.7, -0.68, -0.67, -0.65, -0.63, -0.62, -0.6, -0.58, -0.57, -0.55, -0.53, -0.52, -0.5, -0.48, -0.47, -0.45, -0.43, -0.42, -0.4, -0.38, -0.37, -0.35, -0.33, -0.32, -0.3, -0.28, -0.27, -0.25, -0.23, -0.22, -0.2, -0.18, -0.17, -0.15, -0.13, -0.12, -0.1, -0.08, -0.07, -0.05, -0.03, -0.02, -0.01, 0, 0, 0, 0, 0, 0, 0.01, 0.02, 0.03, 0.05, 0.07, 0.08, 0.1, 0.12, 0.13, 0.15, 0.17, 0.18, 0.2, 0.22, 0.23, 0.25, 0.27, 0.28, 0.3, 0.32, 0.33, 0.35, 0.37, 0.38, 0.4, 0.42, 0.43, 0.45, 0.47, 0.48, 0.5, 0.52, 0.53, 0.55, 0.57, 0.58, 0.6, 0.62, 0.63, 0.65, 0.67, 0.68, 0.7, 0.72, 0.73, 0.75, 0.77, 0.78, 0.8, 0.82, 0.83, 0.85, 0.87, 0.88, 0.9, 0.92, 0.93, 0.95, 0.97, 0.98, 1};
-const float LINEAR_FILTERMIXER[128] = {0, 0.008, 0.016, 0.024, 0.031, 0.039, 0.047, 0.055, 0.063, 0.071, 0.079, 0.087, 0.094, 0.102, 0.11, 0.118, 0.126, 0.134, 0.142, 0.15, 0.157, 0.165, 0.173, 0.181, 0.189, 0.197, 0.205, 0.213, 0.22, 0.228, 0.236, 0.244, 0.252, 0.26, 0.268, 0.276, 0.283, 0.291, 0.299, 0.307, 0.315, 0.323, 0.331, 0.339, 0.346, 0.354, 0.362, 0.37, 0.378, 0.386, 0.394, 0.402, 0.409, 0.417, 0.425, 0.433, 0.441, 0.449, 0.457, 0.465, 0.472, 0.48, 0.488, 0.496, 0.504, 0.512, 0.52, 0.528, 0.535, 0.543, 0.551, 0.559, 0.567, 0.575, 0.583, 0.591, 0.598, 0.606, 0.614, 0.622, 0.63, 0.638, 0.646, 0.654, 0.661, 0.669, 0.677, 0.685, 0.693, 0.701, 0.709, 0.717, 0.724, 0.732, 0.74, 0.748, 0.756, 0.764, 0.772, 0.78, 0.787, 0.795, 0.803, 0.811, 0.819, 0.827, 0.835, 0.843, 0.85, 0.858, 0.866, 0.874, 0.882, 0.89, 0.898, 0.906, 0.913, 0.921, 0.929, 0.937, 0.945, 0.953, 0.961, 0.976, 0.988, 1.0, -99, -99};//{LP...HP,BP,BP}
-const int LINEAR_INVERSE[128] = {127, 126, 125, 124, 123, 122, 121, 120, 119, 118, 117, 116, 115, 114, 113, 112, 111, 110, 109, 108, 107, 106, 105, 104, 103, 102, 101, 100, 99, 98, 97, 96, 95, 94, 93, 92, 91, 90, 89, 88, 87, 86, 85, 84, 83, 82, 81, 80, 79, 78, 77, 76, 75, 74, 73, 72, 71, 70, 69, 68, 67, 66, 65, 64, 63, 62, 61, 60, 59, 58, 57, 56, 55, 54, 53, 52, 51, 50, 49, 48, 47, 46, 45, 44, 43, 42, 41, 40, 39, 38, 37, 36, 35, 34, 33, 32, 31, 30, 29, 28, 27, 26, 25, 24, 23, 22, 21, 20, 19, 18, 17, 16, 15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0};
-const int LINEAR_FILTERMIXERSTR[128] = {0, 1, 2, 2, 3, 4, 5, 6, 6, 7, 8, 9, 9, 10, 11, 12, 13, 13, 14, 15, 16, 17, 17, 18, 19, 20, 20, 21, 22, 23, 24, 24, 25, 26, 27, 28, 28, 29, 30, 31, 31, 32, 33, 34, 35, 35, 36, 37, 38, 39, 39, 40, 41, 42, 43, 43, 44, 45, 46, 46, 47, 48, 49, 50, 50, 51, 52, 53, 54, 54, 55, 56, 57, 57, 58, 59, 60, 61, 61, 62, 63, 64, 65, 65, 66, 67, 68, 69, 69, 70, 71, 72, 72, 73, 74, 75, 76, 76, 77, 78, 79, 80, 80, 81, 82, 83, 83, 84, 85, 86, 87, 87, 88, 89, 90, 91, 91, 92, 93, 94, 94, 95, 96, 97, 98, 99, 100, 100};
-const int LINEAR_NORMAL[128] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16, 17, 18, 19, 20, 21, 22, 23, 24, 25, 26, 27, 28, 29, 30, 31, 32, 33, 34, 35, 36, 37, 38, 39, 40, 41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51, 52, 53, 54, 55, 56, 57, 58, 59, 60, 61, 62, 63, 64, 65, 66, 67, 68, 69, 70, 71, 72, 73, 74, 75, 76, 77, 78, 79, 80, 81, 82, 83, 84, 85, 86, 87, 88, 89, 90, 91, 92, 93, 94, 95, 96, 97, 98, 99, 100, 101, 102, 103, 104, 105, 106, 107, 108, 109, 110, 111, 112, 113, 114, 115, 116, 117, 118, 119, 120, 121, 122, 123, 124, 125, 126, 127};
-const int LINEAR_NEGATIVE[128] = {0, -1, -2, -2, -3, -4, 5, 6, 6, 7, 8, 9, 9, 10, 11, 12, 13, 13, 14, 15, 16, 17, 17, 18, 19, 20, 20, 21, 22, 23, 24, 24, 25, 26, 27, 28, 28, 29, 30, 31, 31, 32, 33, 34, 35, 35, 36, 37, 38, 39, 39, 40, 41, 42, 43, 43, 44, 45, 46, 46, 47, 48, 49, 50, 50, 51, 52, 53, 54, 54, 55, 56, 57, 57, 58, 59, 60, 61, 61, 62, 63, 64, 65, 65, 66, 67, 68, 69, 69, 70, 71, 72, 72, 73, 74, 75, 76, 76, 77, 78, 79, 80, 80, 81, 82, 83, 83, 84, 85, 86, 87, 87, 88, 89, 90, 91, 91, 92, 93, 94, 94, 95, 96, 97, 98, 99, 100, 100};
-const float PWMRATE[128] = { -10, -10, -5, -5, -5, -5, -5, 0.02, 0.03, 0.05, 0.062, 0.075, 0.089, 0.105, 0.122, 0.14, 0.16, 0.18, 0.2, 0.22, 0.25, 0.27, 0.3, 0.33, 0.36, 0.39, 0.42, 0.45, 0.49, 0.52, 0.56, 0.6, 0.63, 0.68, 0.72, 0.76, 0.8, 0.85, 0.9, 0.94, 0.99, 1.04, 1.09, 1.15, 1.2, 1.26, 1.31, 1.37, 1.43, 1.49, 1.55, 1.61, 1.68, 1.74, 1.81, 1.88, 1.94, 2.01, 2.09, 2.16, 2.23, 2.31, 2.38, 2.46, 2.54, 2.62, 2.7, 2.78, 2.87, 2.95, 3.04, 3.13, 3.21, 3.3, 3.4, 3.49, 3.58, 3.68, 3.77, 3.87, 3.97, 4.07, 4.17, 4.27, 4.37, 4.48, 4.59, 4.69, 4.8, 4.91, 5.02, 5.13, 5.25, 5.36, 5.48, 5.6, 5.71, 5.83, 5.95, 6.08, 6.2, 6.32, 6.45, 6.58, 6.71, 6.84, 6.97, 7.1, 7.23, 7.37, 7.5, 7.64, 7.78, 7.92, 8.06, 8.2, 8.34, 8.49, 8.63, 8.78, 8.93, 9.08, 9.23, 9.38, 9.53, 9.69, 9.84, 10};
-const float PULSEWIDTH[128] = {50, 50, 50, 51, 51, 52, 52, 53, 53, 53, 54, 54, 54, 55, 55, 56, 56, 56, 57, 57, 58, 58, 58, 59, 59, 60, 60, 60, 61, 61, 62, 62, 62, 63, 63, 64, 64, 64, 65, 65, 65, 66, 66, 67, 67, 67, 68, 68, 69, 69, 70, 70, 70, 71, 71, 72, 72, 72, 73, 73, 73, 74, 74, 74, 75, 75, 75, 76, 76, 76, 77, 77, 78, 78, 79, 79, 79, 80, 80, 81, 81, 81, 82, 82, 83, 83, 84, 84, 85, 85, 86, 86, 87, 87, 87, 88, 88, 89, 89, 90, 90, 90, 91, 91, 91, 92, 92, 93, 93, 94, 94, 94, 95, 95, 95, 96, 96, 96, 97, 97, 97, 98, 98, 98, 99, 99, 99, 99};
+// Display and rate tables, 128 entries indexed by a 0-1023 value / 8.
+// All const, so they stay in flash. Tables that follow a rule are built by
+// the compiler, the hand tuned curves are listed in the smallest integer type
+// that holds them.
+
+template <typename T, int N>
+struct ConstTable {
+  T v[N];
+  constexpr T operator[](int i) const {
+    return v[i];
+  }
+};
+
+template <typename T, int N, T (*entry)(int)>
+constexpr ConstTable<T, N> makeTable() {
+  ConstTable<T, N> table{};
+  for (int i = 0; i < N; i++) table.v[i] = entry(i);
+  return table;
+}
+
+// Hz
+const uint16_t FILTERCUTOFF[128] = {20, 23, 26, 29, 32, 36, 40, 46, 53, 60, 69, 78, 87, 98, 109, 120, 132, 145, 157, 171, 186, 200, 215, 231, 247, 264, 282, 300, 319, 338, 357, 378, 399, 421, 444, 467, 491, 516, 541, 567, 594, 621, 650, 680, 710, 741, 774, 806, 841, 876, 912, 949, 987, 1027, 1068, 1110, 1152, 1196, 1242, 1290, 1338, 1388, 1439, 1491, 1547, 1603, 1661, 1723, 1783, 1843, 1915, 1975, 2047, 2119, 2191, 2263, 2347, 2419, 2503, 2587, 2683, 2767, 2863, 2959, 3055, 3163, 3259, 3367, 3487, 3595, 3715, 3835, 3967, 4099, 4231, 4363, 4507, 4663, 4807, 4963, 5131, 5287, 5467, 5635, 5815, 6007, 6199, 6403, 6607, 6823, 7039, 7267, 7495, 7735, 7987, 8239, 8503, 8779, 9055, 9343, 9643, 9955, 10267, 10603, 10939, 11287, 11647, 12000};
+// ms
+const uint16_t ENVTIMES[128] = {1, 2, 4, 6, 9, 14, 20, 26, 33, 41, 49, 58, 67, 78, 89, 99, 111, 124, 136, 150, 164, 178, 192, 209, 224, 241, 258, 276, 295, 314, 333, 353, 374, 395, 418, 440, 464, 489, 513, 539, 565, 592, 621, 650, 680, 710, 742, 774, 808, 843, 878, 915, 952, 991, 1031, 1073, 1114, 1158, 1202, 1250, 1297, 1346, 1396, 1448, 1502, 1558, 1614, 1676, 1735, 1794, 1864, 1923, 1994, 2065, 2136, 2207, 2289, 2360, 2443, 2525, 2620, 2702, 2797, 2891, 2985, 3092, 3186, 3292, 3410, 3516, 3634, 3752, 3882, 4012, 4142, 4272, 4413, 4567, 4708, 4862, 5027, 5180, 5357, 5522, 5699, 5888, 6077, 6278, 6478, 6691, 6903, 7127, 7351, 7587, 7835, 8083, 8343, 8614, 8885, 9169, 9464, 9770, 10077, 10408, 10738, 11080, 11434, 11700};
+// LFO display rate in mHz
+const uint16_t LFOTEMPO_MHZ[128] = {50, 50, 55, 55, 60, 64, 64, 69, 72, 77, 77, 81, 80, 87, 87, 92, 100, 100, 100, 104, 109, 115, 115, 122, 130, 130, 139, 149, 160, 160, 172, 185, 196, 200, 200, 210, 220, 240, 240, 260, 270, 290, 290, 310, 340, 370, 370, 390, 400, 400, 420, 450, 470, 470, 500, 530, 570, 570, 600, 620, 620, 650, 690, 740, 740, 800, 800, 860, 860, 940, 1000, 1000, 1100, 1120, 1140, 1140, 1170, 1200, 1300, 1400, 1500, 1500, 1600, 1600, 1700, 1800, 1900, 2000, 2200, 2200, 2400, 2600, 2800, 3000, 3000, 3100, 3200, 3200, 3400, 3800, 3800, 4100, 4400, 4700, 4700, 5000, 5400, 5800, 6000, 6000, 6200, 6400, 6400, 6800, 6800, 7300, 7600, 8000, 8600, 9300, 9900, 10600, 10600, 11500, 12200, 12800, 12800, 12800};
+
+// OSC2 interval, cents over the first quarter then semitones every 4 steps
+constexpr uint8_t intervalEntry(int i) {
+  return i < 32 ? 0 : (i - 32) / 4 + 1;
+}
+constexpr uint8_t intervalSemiEntry(int i) {
+  return i < 32 ? i : (i - 32) / 4 + 1;
+}
+constexpr ConstTable<uint8_t, 128> INTERVAL = makeTable<uint8_t, 128, intervalEntry>();
+constexpr ConstTable<uint8_t, 128> INTERVALSEMI = makeTable<uint8_t, 128, intervalSemiEntry>();
+
+// %
+const uint8_t LINEAR_FILTERMIXERSTR[128] = {0, 1, 2, 2, 3, 4, 5, 6, 6, 7, 8, 9, 9, 10, 11, 12, 13, 13, 14, 15, 16, 17, 17, 18, 19, 20, 20, 21, 22, 23, 24, 24, 25, 26, 27, 28, 28, 29, 30, 31, 31, 32, 33, 34, 35, 35, 36, 37, 38, 39, 39, 40, 41, 42, 43, 43, 44, 45, 46, 46, 47, 48, 49, 50, 50, 51, 52, 53, 54, 54, 55, 56, 57, 57, 58, 59, 60, 61, 61, 62, 63, 64, 65, 65, 66, 67, 68, 69, 69, 70, 71, 72, 72, 73, 74, 75, 76, 76, 77, 78, 79, 80, 80, 81, 82, 83, 83, 84, 85, 86, 87, 87, 88, 89, 90, 91, 91, 92, 93, 94, 94, 95, 96, 97, 98, 99, 100, 100};
+const uint8_t PULSEWIDTH[128] = {50, 50, 50, 51, 51, 52, 52, 53, 53, 53, 54, 54, 54, 55, 55, 56, 56, 56, 57, 57, 58, 58, 58, 59, 59, 60, 60, 60, 61, 61, 62, 62, 62, 63, 63, 64, 64, 64, 65, 65, 65, 66, 66, 67, 67, 67, 68, 68, 69, 69, 70, 70, 70, 71, 71, 72, 72, 72, 73, 73, 73, 74, 74, 74, 75, 75, 75, 76, 76, 76, 77, 77, 78, 78, 79, 79, 79, 80, 80, 81, 81, 81, 82, 82, 83, 83, 84, 84, 85, 85, 86, 86, 87, 87, 87, 88, 88, 89, 89, 90, 90, 90, 91, 91, 91, 92, 92, 93, 93, 94, 94, 94, 95, 95, 95, 96, 96, 96, 97, 97, 97, 98, 98, 98, 99, 99, 99, 99};
+
+// ARP / SEQ step length in us, 0.5Hz to 20Hz exponential over LfoRate 0-1024
+// in steps of 8. lfoStepMicros() interpolates between entries.
+#define LFO_RATE_MIN_HZ 0.5
+#define LFO_RATE_RANGE_LN 3.6888794541139363  // ln(20 / 0.5)
+
+constexpr double constExp(double x) {
+  double sum = 1, term = 1;
+  for (int n = 1; n < 48; n++) {
+    term *= x / n;
+    sum += term;
+  }
+  return sum;
+}
+constexpr uint32_t lfoStepEntry(int i) {
+  return (uint32_t)(1000000.0 / LFO_RATE_MIN_HZ * constExp(-LFO_RATE_RANGE_LN * i / 128) + 0.5);
+}
+constexpr ConstTable<uint32_t, 129> LFO_STEP_US = makeTable<uint32_t, 129, lfoStepEntry>();
+static_assert(LFO_STEP_US[0] == 2000000 && LFO_STEP_US[128] == 50000, "LFO step table ends");
 
 #define RE_READ -9
 #define NO_OF_PARAMS 200
@@ -30,4 +66,4 @@ const char* INITPATCHNAME = "Initial Patch";
 #define HOLD_DURATION 1000
 const uint32_t CLICK_DURATION = 250;
 #define PATCHES_LIMIT 999
-const String INITPATCH = "Solina,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,";
+const char* const INITPATCH = "Solina,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,";
@@ -1,5 +1,16 @@
 #include <EEPROM.h>
 
+// Settings journal
+//
+// All settings live in RAM in one SettingsRecord. store*() only changes RAM,
+// the record is written to EEPROM once nothing has changed for
+// SETTINGS_FLUSH_MS. Each write goes to the next slot of the journal area, so
+// the wear is spread over every slot instead of hitting the same byte.
+// At boot the slot with a good CRC and the newest sequence number wins.
+//
+// Bytes 0-63 are the old one byte per setting layout, read once to migrate
+// when no journal record is found and otherwise left alone.
+
 #define EEPROM_MIDI_CH 0
 #define EEPROM_KEY_MODE 1
 #define EEPROM_PITCHBEND 2
@@ -9,94 +20,279 @@
 #define EEPROM_CLOCK_SOURCE 6
 #define EEPROM_AT_DEPTH 7
 #define EEPROM_AT_DESTINATION 8
+#define EEPROM_SEQ_CLOCK 9
+#define EEPROM_CLOCK_DIV 10
+#define EEPROM_BROWSE_DELAY 11
+
+#define EEPROM_JOURNAL_START 64
+#define EEPROM_JOURNAL_END 4096  // Teensy 3.6
+#define SETTINGS_FLUSH_MS 2000
+
+struct SettingsRecord {
+  uint16_t seq;  // Never 0xFFFF, that is erased EEPROM
+  uint16_t lastPatch;
+  uint8_t midiChannel;
+  uint8_t keyMode;
+  uint8_t pitchBend;
+  uint8_t modWheelDepth;
+  uint8_t encoderDir;
+  uint8_t clockSource;
+  uint8_t atDepth;
+  uint8_t atDestination;
+  uint8_t seqClock;
+  uint8_t clockDiv;
+  uint8_t browseDelay;
+  uint8_t patchSync;
+  uint8_t morphTime;
+  uint8_t patchBank;
+  uint8_t hiResPairs;
+  uint8_t modRoute[4];  // Per MOD_SLOTS slot, 0 for the default route, see getModRoute()
+  uint8_t spare[8];  // Room for new settings without changing the slot size
+  uint8_t crc;
+};
+static_assert(sizeof(SettingsRecord) == 32, "SettingsRecord should fill a 32 byte slot");
+
+#define EEPROM_JOURNAL_SLOTS ((EEPROM_JOURNAL_END - EEPROM_JOURNAL_START) / sizeof(SettingsRecord))
+
+SettingsRecord settingsRec;
+int settingsSlot = -1;  // Slot holding the newest record, -1 if none
+boolean settingsDirty = false;
+elapsedMillis settingsQuietTimer;
+
+uint8_t settingsCrc(const SettingsRecord &r) {
+  const uint8_t *p = (const uint8_t *)&r;
+  uint8_t crc = 0x5A;
+  for (size_t i = 0; i < sizeof(SettingsRecord) - 1; i++) {
+    crc ^= p[i];
+    for (int b = 0; b < 8; b++) crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+  }
+  return crc;
+}
+
+void readSettingsSlot(int slot, SettingsRecord &r) {
+  EEPROM.get(EEPROM_JOURNAL_START + slot * sizeof(SettingsRecord), r);
+}
+
+boolean settingsRecordValid(const SettingsRecord &r) {
+  return r.seq != 0xFFFF && r.crc == settingsCrc(r);
+}
+
+// Old layout, each byte checked the same way the old getters did
+void migrateLegacySettings() {
+  byte b;
+  b = EEPROM.read(EEPROM_MIDI_CH);
+  settingsRec.midiChannel = b > 16 ? MIDI_CHANNEL_OMNI : b;
+  b = EEPROM.read(EEPROM_KEY_MODE);
+  settingsRec.keyMode = b > 2 ? 0 : b;
+  b = EEPROM.read(EEPROM_PITCHBEND);
+  settingsRec.pitchBend = b > 12 ? pitchBendRange : b;
+  b = EEPROM.read(EEPROM_MODWHEEL_DEPTH);
+  settingsRec.modWheelDepth = b > 10 ? modWheelDepth : b;
+  b = EEPROM.read(EEPROM_ENCODER_DIR);
+  settingsRec.encoderDir = b > 1 ? 1 : b;
+  b = EEPROM.read(EEPROM_CLOCK_SOURCE);
+  settingsRec.clockSource = b > 1 ? clocksource : b;
+  b = EEPROM.read(EEPROM_AT_DEPTH);
+  settingsRec.atDepth = b > 10 ? afterTouchDepth : b;
+  settingsRec.atDestination = EEPROM.read(EEPROM_AT_DESTINATION);
+  b = EEPROM.read(EEPROM_SEQ_CLOCK);
+  settingsRec.seqClock = b > 1 ? 0 : b;
+  b = EEPROM.read(EEPROM_CLOCK_DIV);
+  settingsRec.clockDiv = b > 6 ? 3 : b;
+  b = EEPROM.read(EEPROM_BROWSE_DELAY);
+  settingsRec.browseDelay = b > 3 ? 1 : b;
+  b = EEPROM.read(EEPROM_LAST_PATCH);
+  settingsRec.lastPatch = b < 1 ? 1 : b;
+  settingsRec.patchSync = 0;
+  settingsRec.morphTime = 1;
+  settingsRec.patchBank = 0;
+  settingsRec.hiResPairs = 0;
+  settingsRec.seq = 0;
+}
+
+// Call before any get*()
+void loadSettingsJournal() {
+  SettingsRecord r;
+  settingsSlot = -1;
+  for (int slot = 0; slot < (int)EEPROM_JOURNAL_SLOTS; slot++) {
+    readSettingsSlot(slot, r);
+    if (!settingsRecordValid(r)) continue;
+    if (settingsSlot < 0 || (int16_t)(r.seq - settingsRec.seq) > 0) {
+      settingsRec = r;
+      settingsSlot = slot;
+    }
+  }
+  if (settingsSlot < 0) {
+    migrateLegacySettings();
+    settingsDirty = true;
+  }
+}
+
+void flushSettings() {
+  settingsSlot = (settingsSlot + 1) % EEPROM_JOURNAL_SLOTS;
+  settingsRec.seq++;
+  if (settingsRec.seq == 0xFFFF) settingsRec.seq = 0;
+  settingsRec.crc = settingsCrc(settingsRec);
+  EEPROM.put(EEPROM_JOURNAL_START + settingsSlot * sizeof(SettingsRecord), settingsRec);
+  settingsDirty = false;
+}
+
+// From loop(), writes once the settings have been left alone for a while
+void checkSettingsFlush() {
+  if (settingsDirty && settingsQuietTimer >= SETTINGS_FLUSH_MS) flushSettings();
+}
+
+template<typename T>
+void setSetting(T &field, T value) {
+  if (field == value) return;
+  field = value;
+  settingsDirty = true;
+  settingsQuietTimer = 0;
+}
 
 int getMIDIChannel() {
-  byte midiChannel = EEPROM.read(EEPROM_MIDI_CH);
-  if (midiChannel < 0 || midiChannel > 16) midiChannel = MIDI_CHANNEL_OMNI;//If EEPROM has no MIDI channel stored
-  return midiChannel;
+  return settingsRec.midiChannel;
 }
 
 void storeMidiChannel(byte channel)
 {
-  EEPROM.update(EEPROM_MIDI_CH, channel);
+  setSetting(settingsRec.midiChannel, (uint8_t)channel);
 }
 
 int getPitchBendRange() {
-  byte pitchbend = EEPROM.read(EEPROM_PITCHBEND);
-  if (pitchbend < 0 || pitchbend > 12) return pitchBendRange; //If EEPROM has no pitchbend stored
-  return pitchbend;
+  return settingsRec.pitchBend;
 }
 
 void storePitchBendRange(byte pitchbend)
 {
-  EEPROM.update(EEPROM_PITCHBEND, pitchbend);
+  setSetting(settingsRec.pitchBend, (uint8_t)pitchbend);
 }
 
 int getModWheelDepth() {
-  byte mw = EEPROM.read(EEPROM_MODWHEEL_DEPTH);
-  if (mw < 0 || mw > 10) return modWheelDepth; //If EEPROM has no mod wheel depth stored
-  return mw;
+  return settingsRec.modWheelDepth;
 }
 
 void storeModWheelDepth(byte mwDepth)
 {
-  byte mw = mwDepth;
-  EEPROM.update(EEPROM_MODWHEEL_DEPTH, mw);
+  setSetting(settingsRec.modWheelDepth, (uint8_t)mwDepth);
 }
 
 int getAfterTouchDepth() {
-  byte at = EEPROM.read(EEPROM_AT_DEPTH);
-  if (at < 0 || at > 10) return afterTouchDepth; //If EEPROM has no mod wheel depth stored
-  return at;
+  return settingsRec.atDepth;
 }
 
 void storeAfterTouchDepth(byte atDepth)
 {
-  byte at = atDepth;
-  EEPROM.update(EEPROM_AT_DEPTH, at);
+  setSetting(settingsRec.atDepth, (uint8_t)atDepth);
 }
 
 boolean getEncoderDir() {
-  byte ed = EEPROM.read(EEPROM_ENCODER_DIR); 
-  if (ed < 0 || ed > 1)return true; //If EEPROM has no encoder direction stored
-  return ed == 1 ? true : false;
+  return settingsRec.encoderDir == 1 ? true : false;
 }
 
 void storeEncoderDir(byte encoderDir)
 {
-  EEPROM.update(EEPROM_ENCODER_DIR, encoderDir);
+  setSetting(settingsRec.encoderDir, (uint8_t)encoderDir);
 }
 
 float getKeyMode() {
-  byte keyMode = EEPROM.read(EEPROM_KEY_MODE);
-  if (keyMode < 0 || keyMode > 2) return keyMode;
-  return keyMode; //If EEPROM has no key tracking stored
+  return settingsRec.keyMode;
 }
 
 void storeKeyMode(float keyMode)
 {
-  EEPROM.update(EEPROM_KEY_MODE, keyMode);
+  setSetting(settingsRec.keyMode, (uint8_t)keyMode);
 }
 
 int getClockSource() {
-  byte cs = EEPROM.read(EEPROM_CLOCK_SOURCE);
-  if (cs < 0 || cs > 1) return clocksource; //If EEPROM has no mod wheel depth stored
-  return cs;
+  return settingsRec.clockSource;
 }
 
 void storeClockSource(byte clocksource)
 {
-  byte cs =  clocksource;
-  EEPROM.update(EEPROM_CLOCK_SOURCE, cs);
+  setSetting(settingsRec.clockSource, (uint8_t)clocksource);
 }
 
 int getLastPatch() {
-  int lastPatchNumber = EEPROM.read(EEPROM_LAST_PATCH);
+  int lastPatchNumber = settingsRec.lastPatch;
   if (lastPatchNumber < 1 || lastPatchNumber > 999) lastPatchNumber = 1;
   return lastPatchNumber;
 }
 
 void storeLastPatch(int lastPatchNumber)
 {
-  EEPROM.update(EEPROM_LAST_PATCH, lastPatchNumber);
+  setSetting(settingsRec.lastPatch, (uint16_t)lastPatchNumber);
+}
+
+int getSeqClock() {
+  return settingsRec.seqClock;
+}
+
+void storeSeqClock(byte seqClock)
+{
+  setSetting(settingsRec.seqClock, (uint8_t)seqClock);
+}
+
+int getClockDiv() {
+  return settingsRec.clockDiv;
+}
+
+void storeClockDiv(byte clockDiv)
+{
+  setSetting(settingsRec.clockDiv, (uint8_t)clockDiv);
+}
+
+int getBrowseDelay() {
+  return settingsRec.browseDelay;
+}
+
+void storeBrowseDelay(byte browseDelayIndex)
+{
+  setSetting(settingsRec.browseDelay, (uint8_t)browseDelayIndex);
+}
+
+int getPatchSync() {
+  return settingsRec.patchSync > 1 ? 0 : settingsRec.patchSync;
+}
+
+void storePatchSync(byte patchSync)
+{
+  setSetting(settingsRec.patchSync, (uint8_t)patchSync);
+}
+
+int getMorphTime() {
+  return settingsRec.morphTime > 5 ? 1 : settingsRec.morphTime;
+}
+
+void storeMorphTime(byte morphTime)
+{
+  setSetting(settingsRec.morphTime, (uint8_t)morphTime);
+}
+
+int getPatchBank() {
+  return settingsRec.patchBank > PATCH_BANKS ? 0 : settingsRec.patchBank;
+}
+
+void storePatchBank(byte bank)
+{
+  setSetting(settingsRec.patchBank, (uint8_t)bank);
+}
+
+int getHiResPairs() {
+  return settingsRec.hiResPairs > 1 ? 0 : settingsRec.hiResPairs;
+}
+
+void storeHiResPairs(byte hiResPairs)
+{
+  setSetting(settingsRec.hiResPairs, (uint8_t)hiResPairs);
+}
+
+// 0x80 | source << 4 | destination once set from the settings page
+int getModRoute(uint8_t slot) {
+  return settingsRec.modRoute[slot & 3];
+}
+
+void storeModRoute(uint8_t slot, byte route)
+{
+  setSetting(settingsRec.modRoute[slot & 3], (uint8_t)route);
 }
@@ -0,0 +1,149 @@
+// External clock input for the arpeggiator and sequencer
+//
+// Rising edges on EXT_CLOCK_IN are timestamped with the cycle counter at the
+// start of the pin interrupt and the arp/seq step is played from the same
+// interrupt, so the step follows the edge within a few microseconds. Loop
+// code playing notes or changing the arp/seq state holds the interrupt off
+// with a VoiceLock (Source.ino) meanwhile. The period is tracked with a
+// moving average and used to scale gate lengths and to space the extra
+// steps when multiplying the clock.
+//
+// Define EXT_CLOCK_SIMULATE to replace the pin with a timer generated clock
+// with random jitter. Period, jitter and latency figures are then printed to
+// the serial port every couple of seconds.
+
+//#define EXT_CLOCK_SIMULATE
+
+#define SEQ_CLOCK_INTERNAL 0
+#define SEQ_CLOCK_EXTERNAL 1
+
+#define CYCLES_PER_US (F_CPU / 1000000)
+#define EXT_CLOCK_MIN_PERIOD_US 2000UL     // Faster than this is treated as a glitch
+#define EXT_CLOCK_TIMEOUT_US 2000000UL     // Slower than this restarts the estimate
+
+// Defined in Source.ino
+void seqClockStep();
+void arpClockStep();
+void setSeqStepTiming(uint32_t stepMicros);
+
+int seqClockSource = SEQ_CLOCK_INTERNAL;  //(EEPROM)
+int clockDivIndex = 3;                     //(EEPROM) index into the "Clock Div" setting, 3 is 1:1
+
+volatile uint8_t extClockDiv = 1;
+volatile uint8_t extClockMult = 1;
+volatile uint8_t extClockDivCount = 0;
+volatile uint8_t extClockSubSteps = 0;
+
+volatile uint32_t extClockLastEdge = 0;
+volatile uint32_t extClockPeriod = 0;  // Moving average in cycles, 0 until the first full period
+volatile uint32_t extClockEdges = 0;
+
+// Statistics
+volatile uint32_t extClockJitterMax = 0;   // Largest deviation of a period from the estimate, cycles
+volatile uint32_t extClockLatencyMax = 0;  // Edge to step played, cycles
+
+IntervalTimer extClockSubTimer;
+
+inline uint32_t extClockPeriodMicros() {
+  return extClockPeriod / CYCLES_PER_US;
+}
+
+void extClockStep() {
+  if (seqEnabled) {
+    seqClockStep();
+  } else if (arpEnabled) {
+    arpClockStep();
+  }
+}
+
+void extClockSubIsr() {
+  extClockStep();
+  if (extClockSubSteps == 0 || --extClockSubSteps == 0) extClockSubTimer.end();
+}
+
+void extClockEdge(uint32_t now) {
+  uint32_t period = now - extClockLastEdge;
+  if (period < EXT_CLOCK_MIN_PERIOD_US * CYCLES_PER_US) return;  // The next period runs from the last real edge
+  extClockLastEdge = now;
+
+  if (period > EXT_CLOCK_TIMEOUT_US * CYCLES_PER_US) {
+    // Clock (re)started, play straight away but don't let the gap skew the estimate
+    extClockDivCount = 0;
+  } else if (extClockPeriod == 0) {
+    extClockPeriod = period;
+  } else {
+    int32_t error = (int32_t)(period - extClockPeriod);
+    uint32_t deviation = error < 0 ? -error : error;
+    if (deviation > extClockJitterMax) extClockJitterMax = deviation;
+    extClockPeriod += error >> 3;
+  }
+  extClockEdges++;
+
+  if (seqClockSource != SEQ_CLOCK_EXTERNAL) return;
+
+  if (extClockDivCount == 0) {
+    if (extClockPeriod) {
+      uint32_t stepMicros = extClockPeriodMicros() * extClockDiv / extClockMult;
+      setSeqStepTiming(stepMicros);
+      if (extClockMult > 1) {
+        extClockSubTimer.end();
+        extClockSubSteps = extClockMult - 1;
+        extClockSubTimer.begin(extClockSubIsr, stepMicros);
+      }
+    }
+    extClockStep();
+    uint32_t latency = ARM_DWT_CYCCNT - now;
+    if (latency > extClockLatencyMax) extClockLatencyMax = latency;
+  }
+  if (++extClockDivCount >= extClockDiv) extClockDivCount = 0;
+}
+
+void extClockEdgeIsr() {
+  extClockEdge(ARM_DWT_CYCCNT);
+}
+
+// Values of the "Clock Div" setting, slower to faster
+void setClockDivIndex(int index) {
+  clockDivIndex = constrain(index, 0, 6);
+  extClockDiv = clockDivIndex < 3 ? 4 - clockDivIndex : 1;
+  extClockMult = clockDivIndex > 3 ? clockDivIndex - 2 : 1;
+  extClockDivCount = 0;
+}
+
+#ifdef EXT_CLOCK_SIMULATE
+IntervalTimer extClockSimTimer;
+uint32_t extClockSimPeriodUs = 125000;  // 120bpm 1/8ths
+uint32_t extClockSimJitterUs = 1000;
+elapsedMillis extClockReportTimer;
+
+void extClockSimIsr() {
+  extClockEdge(ARM_DWT_CYCCNT);
+  int32_t next = extClockSimPeriodUs + random(-(int32_t)extClockSimJitterUs, extClockSimJitterUs + 1);
+  extClockSimTimer.end();
+  extClockSimTimer.begin(extClockSimIsr, (uint32_t)next);
+}
+#endif
+
+void extClockReport() {
+#ifdef EXT_CLOCK_SIMULATE
+  if (extClockReportTimer < 2000) return;
+  extClockReportTimer = 0;
+  Serial.print("Ext Clk period:");
+  Serial.print(extClockPeriodMicros());
+  Serial.print("us jitter max:");
+  Serial.print(extClockJitterMax / CYCLES_PER_US);
+  Serial.print("us latency max:");
+  Serial.print(extClockLatencyMax / CYCLES_PER_US);
+  Serial.println("us");
+#endif
+}
+
+void setupExtClock() {
+  setClockDivIndex(clockDivIndex);
+#ifdef EXT_CLOCK_SIMULATE
+  extClockSimTimer.begin(extClockSimIsr, extClockSimPeriodUs);
+#else
+  pinMode(EXT_CLOCK_IN, INPUT);
+  attachInterrupt(digitalPinToInterrupt(EXT_CLOCK_IN), extClockEdgeIsr, RISING);
+#endif
+}
@@ -26,6 +26,7 @@ ADC *adc = new ADC();
 #define GATE_NOTE1 23
 #define TRIG_NOTE1 22
 #define CLOCK 19
+#define EXT_CLOCK_IN 3
 
 //Note DAC
 #define DAC_NOTE1 16
@@ -228,6 +229,15 @@ static int mux2Read = 0;
 
 static long encPrevious = 0;
 
+//Encoder patch browsing, the name updates per detent and the patch is only
+//recalled once the encoder has been still for browseDelay
+#define BROWSE_FAST_MS 30    //Detents closer than this move 5 patches
+#define BROWSE_MEDIUM_MS 80  //and this 2
+static unsigned int browseDelay = 300;  //(EEPROM) ms
+static boolean browsePending = false;
+static elapsedMillis browseTimer;
+static elapsedMillis encStepTimer;
+
 //These are pushbuttons and require debouncing
 Bounce osc1_32Switch = Bounce(OSC1_32, DEBOUNCE);
 Bounce osc1_16Switch = Bounce(OSC1_16, DEBOUNCE);
@@ -0,0 +1,59 @@
+// Panel LED shadow buffer
+//
+// ledSet() only changes a bit in RAM. flushLeds() runs once per loop() and
+// shifts all six registers out with a single latch, and only when the
+// output has actually changed. A patch change that touches 30 LEDs is one
+// shift-out instead of 30.
+//
+// Blink and pulse are masks applied at flush time from a millis() phase, so
+// an animated LED costs nothing beyond the flush that happens anyway when the
+// phase changes.
+
+#define LED_REGISTERS 6
+#define LED_PHASE_SHIFT 7  // 128ms animation steps
+
+uint64_t ledFrame = 0;       // Steady state, bit n is srpanel output n
+uint64_t ledBlinkMask = 0;   // 256ms on, 256ms off
+uint64_t ledPulseMask = 0;   // Inverted for 128ms once a second
+uint64_t ledShown = ~0ULL;   // Unknown at power up, forces the first write
+boolean ledDirty = true;
+
+inline void ledSet(uint8_t led, uint8_t value) {
+  uint64_t bit = 1ULL << led;
+  uint64_t frame = value ? (ledFrame | bit) : (ledFrame & ~bit);
+  if (frame != ledFrame) {
+    ledFrame = frame;
+    ledDirty = true;
+  }
+}
+
+inline void ledBlink(uint8_t led, boolean on) {
+  if (on) ledBlinkMask |= 1ULL << led;
+  else ledBlinkMask &= ~(1ULL << led);
+  ledDirty = true;
+}
+
+inline void ledPulse(uint8_t led, boolean on) {
+  if (on) ledPulseMask |= 1ULL << led;
+  else ledPulseMask &= ~(1ULL << led);
+  ledDirty = true;
+}
+
+void flushLeds() {
+  uint64_t out = ledFrame;
+  if (ledBlinkMask | ledPulseMask) {
+    uint32_t phase = millis() >> LED_PHASE_SHIFT;
+    if (phase & 2) out &= ~ledBlinkMask;
+    else out |= ledBlinkMask;
+    if ((phase & 7) == 0) out ^= ledPulseMask;
+  } else if (!ledDirty) {
+    return;
+  }
+  ledDirty = false;
+  if (out == ledShown) return;
+  ledShown = out;
+
+  uint8_t regs[LED_REGISTERS];
+  for (int i = 0; i < LED_REGISTERS; i++) regs[i] = (uint8_t)(out >> (i * 8));
+  srpanel.setAll(regs);
+}
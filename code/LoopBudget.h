@@ -0,0 +1,90 @@
+// Loop budget
+//
+// Times every loop() against LOOP_BUDGET_US. A run of overruns raises the
+// shed level, a long run of quiet loops lowers it again:
+//   0  everything at full rate
+//   1  display thread waits between frames
+//   2  display slower still, pots scanned every other loop, LEDs every 4th
+// MIDI, gates, the DAC refresh and the arp/seq timers are never shed.
+//
+// The figures are shown on the "Diagnostics" settings page, with the CPU
+// taken by the modulation matrix ISR and the time of the last patch search.
+
+#define LOOP_BUDGET_US 1000
+#define SHED_MAX 2
+#define SHED_RAISE_OVERRUNS 4    // Consecutive overruns before shedding more
+#define SHED_LOWER_LOOPS 2000    // Consecutive loops under half budget before shedding less
+#define DIAG_REFRESH_MS 250
+
+const uint16_t SHED_DISPLAY_DELAY_MS[SHED_MAX + 1] = { 0, 40, 100 };
+
+volatile uint16_t displayFrameDelay = 0;  // Read by the display thread
+
+uint32_t loopStartMicros = 0;
+uint32_t loopCount = 0;
+uint32_t loopOverruns = 0;
+uint32_t loopMaxMicros = 0;
+uint32_t loopAvgMicros8 = 0;  // Moving average x8
+uint8_t shedLevel = 0;
+uint16_t overrunRun = 0;
+uint16_t quietRun = 0;
+
+// Values for the Diagnostics page, refreshed in place
+char diagValues[6][20];
+elapsedMillis diagTimer;
+
+inline void loopBudgetBegin() {
+  loopStartMicros = micros();
+  loopCount++;
+}
+
+inline boolean shedPots() {
+  return shedLevel >= 2 && (loopCount & 1);
+}
+
+inline boolean shedLeds() {
+  return shedLevel >= 2 && (loopCount & 3);
+}
+
+void setShedLevel(uint8_t level) {
+  shedLevel = level;
+  displayFrameDelay = SHED_DISPLAY_DELAY_MS[level];
+  overrunRun = 0;
+  quietRun = 0;
+}
+
+void loopBudgetEnd() {
+  uint32_t elapsed = micros() - loopStartMicros;
+  if (elapsed > loopMaxMicros) loopMaxMicros = elapsed;
+  loopAvgMicros8 = loopAvgMicros8 - (loopAvgMicros8 >> 3) + elapsed;
+
+  if (elapsed > LOOP_BUDGET_US) {
+    loopOverruns++;
+    quietRun = 0;
+    if (++overrunRun >= SHED_RAISE_OVERRUNS && shedLevel < SHED_MAX) setShedLevel(shedLevel + 1);
+  } else {
+    overrunRun = 0;
+    if (elapsed < LOOP_BUDGET_US / 2 && ++quietRun >= SHED_LOWER_LOOPS && shedLevel > 0) setShedLevel(shedLevel - 1);
+  }
+
+  if (diagTimer >= DIAG_REFRESH_MS) {
+    diagTimer = 0;
+    snprintf(diagValues[0], sizeof(diagValues[0]), "Avg %luus", (unsigned long)(loopAvgMicros8 >> 3));
+    snprintf(diagValues[1], sizeof(diagValues[1]), "Max %luus", (unsigned long)loopMaxMicros);
+    snprintf(diagValues[2], sizeof(diagValues[2]), "Over %lu", (unsigned long)loopOverruns);
+    snprintf(diagValues[3], sizeof(diagValues[3]), "Shed %d", shedLevel);
+    uint32_t modPermille = modCpuPermille();
+    snprintf(diagValues[4], sizeof(diagValues[4]), "Mod %lu.%lu%%", (unsigned long)(modPermille / 10), (unsigned long)(modPermille % 10));
+    snprintf(diagValues[5], sizeof(diagValues[5]), "Search %luus", (unsigned long)searchMicros);
+  }
+}
+
+// Selecting a value on the Diagnostics page clears the counters
+void settingsDiagnostics(int index, const char *value) {
+  loopMaxMicros = 0;
+  loopOverruns = 0;
+}
+
+int currentIndexDiagnostics() {
+  return 0;
+}
@@ -1,5 +1,6 @@
 //MIDI CC control numbers
 //These broadly follow standard CC assignments
+#define   CCbankSelect  0 //MSB only, picks the bank for the next program change
 #define   CCmodwheel  1 //pitch LFO amount - less from mod wheel
 #define   CCLfoDepth  3 //pitch LFO amount - panel control
 #define   CCglide  5
@@ -76,4 +77,16 @@
 #define   CCampSustain  97
 #define   CCampRelease 98
 #define   CCosc1level  103
+#define   CCmodLfo3Rate  104
+#define   CCmodLfo4Rate  105
+#define   CCmodEnvRate  106
+#define   CCmodSHRate  107
+#define   CCmodDepth1  108
+#define   CCmodDepth2  109
+#define   CCmodDepth3  110
+#define   CCmodDepth4  111
+#define   CCmorphPatch  112 //Morph to patch value + 1
+#define   CCmorphPosition  113
+#define   CCpatchCompare  114 //On shows the stored patch, off the edits
+#define   CCpatchUndo  115 //Undo the last patch load
 #define   CCallnotesoff 123//Panic button
@@ -0,0 +1,136 @@
+// High resolution CC input
+//
+// 7 bit CCs reach the parameters as value << 3, in steps of 8. Two ways in
+// give the full 10 bits the pots have:
+//
+// NRPN, always on. NRPN 0 / n drives CC n in MidiCC.h:
+//   CC 99 0, CC 98 n     select, within NRPN_SELECT_MS of each other
+//   CC 6 msb             applied at once at 7 bits
+//   CC 38 lsb            optional, applied at 14 bits
+// 98 and 38 are also CCampRelease and CCosc2_saw here, so they are only
+// taken as NRPN straight after 99 / 6. A selection lapses after
+// NRPN_TIMEOUT_MS without NRPN traffic, or on an RPN select (101 / 100).
+//
+// 14 bit CC pairs, with the "14 bit CC" setting on. The continuous
+// parameters below CC 32 (HIRES_MSB_CCS) take CC n + 32 as their LSB when
+// it comes within HIRES_PAIR_MS of the MSB. The MSB is applied as soon as it
+// arrives, so a sender without LSBs loses nothing. Off by default as those
+// LSB numbers are panel switches here.
+//
+// Everything else pays one table read per message, see hiResControlChange().
+
+#define NRPN_SELECT_MS 20
+#define NRPN_TIMEOUT_MS 1000
+#define HIRES_PAIR_MS 10
+
+#define CCnrpnMsb 99
+#define CCnrpnLsb 98
+#define CCdataMsb 6
+#define CCdataLsb 38
+#define CCrpnMsb 101
+#define CCrpnLsb 100
+
+const uint8_t HIRES_MSB_CCS[] = { CCmodwheel, CCLfoDepth, CCglide, CCvolume, CCosc1PW, CCosc2PW, CCosc1PWM, CCosc2PWM, CCnoiseLevel };
+
+enum HiResRole : uint8_t {
+  HR_NONE,
+  HR_NRPN,   // 99, 98, 6, 38, 101, 100
+  HR_MSB,    // 14 bit MSB
+  HR_LSB     // 14 bit LSB, number - 32
+};
+
+struct NrpnState {
+  uint8_t param = 0xFF;     // Selected parameter, 0xFF none
+  uint8_t dataMsb = 0xFF;   // Last CC 6, 0xFF none
+  boolean msbSeen = false;  // CC 99 0 waiting for its 98
+  uint32_t lastMs = 0;
+};
+
+HiResRole hiResRole[128];
+NrpnState nrpnState[16];
+uint8_t hiResMsbValue[16][32];
+uint32_t hiResMsbMs[16][32];
+boolean hiResPairs = false;  //(EEPROM)
+
+void hiResSetup(boolean pairs) {
+  hiResPairs = pairs;
+  memset(hiResRole, HR_NONE, sizeof(hiResRole));
+  hiResRole[CCnrpnMsb] = HR_NRPN;
+  hiResRole[CCnrpnLsb] = HR_NRPN;
+  hiResRole[CCdataMsb] = HR_NRPN;
+  hiResRole[CCdataLsb] = HR_NRPN;
+  hiResRole[CCrpnMsb] = HR_NRPN;
+  hiResRole[CCrpnLsb] = HR_NRPN;
+  if (!pairs) return;
+  for (uint8_t cc : HIRES_MSB_CCS) {
+    hiResRole[cc] = HR_MSB;
+    if (hiResRole[cc + 32] == HR_NONE) hiResRole[cc + 32] = HR_LSB;
+  }
+}
+
+// 14 bit value to the 0-1023 the pots give
+inline int hiResValue(uint8_t msb, uint8_t lsb) {
+  return ((msb << 7) | lsb) >> 4;
+}
+
+// True if the message was taken here, false to handle it as a plain CC
+boolean nrpnControlChange(byte channel, byte number, byte value) {
+  NrpnState &n = nrpnState[(channel - 1) & 15];
+  uint32_t now = millis();
+  boolean live = n.param != 0xFF && now - n.lastMs < NRPN_TIMEOUT_MS;
+
+  switch (number) {
+    case CCnrpnMsb:
+      n.msbSeen = value == 0;
+      n.param = 0xFF;
+      n.lastMs = now;
+      return true;
+    case CCnrpnLsb:
+      if (!n.msbSeen || now - n.lastMs >= NRPN_SELECT_MS) return false;
+      n.msbSeen = false;
+      n.param = value;
+      n.dataMsb = 0xFF;
+      n.lastMs = now;
+      return true;
+    case CCdataMsb:
+      if (!live) return false;
+      n.dataMsb = value;
+      n.lastMs = now;
+      midiDispatch(channel, n.param, value << 3);
+      return true;
+    case CCdataLsb:
+      if (!live || n.dataMsb == 0xFF) return false;
+      n.lastMs = now;
+      midiDispatch(channel, n.param, hiResValue(n.dataMsb, value));
+      return true;
+    case CCrpnMsb:
+    case CCrpnLsb:
+      n.param = 0xFF;
+      n.msbSeen = false;
+      return false;
+  }
+  return false;
+}
+
+boolean hiResControlChange(byte channel, byte number, byte value) {
+  switch (hiResRole[number & 127]) {
+    case HR_NONE:
+      return false;
+    case HR_NRPN:
+      return nrpnControlChange(channel, number, value);
+    case HR_MSB:
+      hiResMsbValue[(channel - 1) & 15][number] = value;
+      hiResMsbMs[(channel - 1) & 15][number] = millis();
+      return false;
+    case HR_LSB:
+      {
+        uint8_t msb = number - 32;
+        uint8_t ch = (channel - 1) & 15;
+        if (millis() - hiResMsbMs[ch][msb] >= HIRES_PAIR_MS) return false;
+        hiResMsbMs[ch][msb] -= HIRES_PAIR_MS;  // One LSB per MSB
+        midiDispatch(channel, ccRemap[ch][msb], hiResValue(hiResMsbValue[ch][msb], value));
+        return true;
+      }
+  }
+  return false;
+}
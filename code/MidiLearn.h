@@ -0,0 +1,118 @@
+// MIDI learn
+//
+// Incoming CCs go through ccRemap before myControlChange() sees them, one
+// table read per message. Each channel has 128 entries, all the identity
+// until something is learned.
+//
+// To learn, hold a panel button, or set "MIDI Learn" to On and move a pot
+// or press a button: that control's CC is armed and the display shows it
+// with the seconds left. The next CC to arrive is then mapped to it on the
+// channel it came in on. The mapping is in force at once and written to
+// CCMAP_FILE. "Clear" puts every channel back to the fixed numbers in
+// MidiCC.h. The original CC of a learned control still works as well.
+//
+// Back, pressing the armed button again or CC_LEARN_TIMEOUT_MS without a
+// CC cancels. NRPN, RPN, data entry and 14 bit pair CCs (MidiHiRes.h) are
+// not taken, they carry other parameters.
+//
+// Only the changed entries are saved, 3 bytes each: channel, from, to.
+
+#define CCMAP_FILE "/MIDI/CCMAP.BIN"  // In a directory so the patch list skips it
+#define CC_LEARN_NONE 0xFF
+#define CC_LEARN_TIMEOUT_MS 5000
+
+uint8_t ccRemap[16][128];
+boolean ccLearnMode = false;              // "MIDI Learn" On, panel moves arm
+uint8_t ccLearnTarget = CC_LEARN_NONE;    // Armed, waiting for a controller
+boolean ccFromMidi = false;               // myControlChange() was called for a MIDI message
+elapsedMillis ccLearnTimer;
+uint8_t ccLearnShown = 0;                 // Seconds left on the display
+
+// For CCs that have come in over MIDI, so they don't arm learning
+void midiDispatch(byte channel, byte control, int value) {
+  ccFromMidi = true;
+  myControlChange(channel, control, value);
+  ccFromMidi = false;
+}
+
+void ccRemapReset() {
+  for (int ch = 0; ch < 16; ch++) {
+    for (int cc = 0; cc < 128; cc++) ccRemap[ch][cc] = cc;
+  }
+}
+
+void ccRemapSave() {
+  if (!cardStatus) return;
+  SD.mkdir("/MIDI");
+  SD.remove(CCMAP_FILE);
+  File file = SD.open(CCMAP_FILE, FILE_WRITE);
+  if (!file) return;
+  for (int ch = 0; ch < 16; ch++) {
+    for (int cc = 0; cc < 128; cc++) {
+      if (ccRemap[ch][cc] == cc) continue;
+      uint8_t record[3] = { (uint8_t)ch, (uint8_t)cc, ccRemap[ch][cc] };
+      file.write(record, sizeof(record));
+    }
+  }
+  file.close();
+}
+
+// Over the identity table from ccRemapReset()
+void ccRemapLoad() {
+  File file = SD.open(CCMAP_FILE);
+  if (!file) return;
+  uint8_t record[3];
+  while (file.read(record, sizeof(record)) == sizeof(record)) {
+    if (record[0] < 16 && record[1] < 128 && record[2] < 128) ccRemap[record[0]][record[1]] = record[2];
+  }
+  file.close();
+}
+
+void midiLearnShow() {
+  ccLearnShown = (CC_LEARN_TIMEOUT_MS - ccLearnTimer + 999) / 1000;
+  showCurrentParameterPage("MIDI Learn", "Armed CC" + String(ccLearnTarget) + " " + String(ccLearnShown) + "s");
+}
+
+// A pot moving on keeps its arming alive
+void midiLearnArm(uint8_t control) {
+  ccLearnTimer = 0;
+  if (control == ccLearnTarget) return;
+  ccLearnTarget = control;
+  midiLearnShow();
+}
+
+// False when nothing was armed
+boolean midiLearnCancel() {
+  if (ccLearnTarget == CC_LEARN_NONE) return false;
+  ccLearnTarget = CC_LEARN_NONE;
+  showCurrentParameterPage("MIDI Learn", "Cancelled");
+  return true;
+}
+
+// From loop(), counts down on the display while armed
+void checkMidiLearn() {
+  if (ccLearnTarget == CC_LEARN_NONE) return;
+  if (ccLearnTimer >= CC_LEARN_TIMEOUT_MS) {
+    ccLearnTarget = CC_LEARN_NONE;
+    showCurrentParameterPage("MIDI Learn", "Timed out");
+  } else if ((CC_LEARN_TIMEOUT_MS - ccLearnTimer + 999) / 1000 != ccLearnShown) {
+    midiLearnShow();
+  }
+}
+
+// The armed control takes this CC on this channel
+void midiLearn(byte channel, byte number) {
+  ccRemap[(channel - 1) & 15][number & 127] = ccLearnTarget;
+  showCurrentParameterPage("MIDI Learn", "Ch" + String(channel) + " CC" + String(number) + " > " + String(ccLearnTarget));
+  ccLearnTarget = CC_LEARN_NONE;
+  ccRemapSave();
+}
+
+void midiLearnMode(int index) {
+  ccLearnMode = index == 1;
+  ccLearnTarget = CC_LEARN_NONE;
+  if (index == 2) {
+    ccRemapReset();
+    ccRemapSave();
+  }
+}
@@ -0,0 +1,90 @@
+// Panel to MIDI out
+//
+// Pot and button moves are sent as CCs on DIN and USB, on the MIDI channel
+// (channel 1 when that is All). Nothing is sent for CCs that came in over
+// MIDI, so there is no echo.
+//
+// Each CC holds only its latest value plus a pending bit per output, so a
+// pot sweep queues one message for that pot however fast it moves, and
+// pending CCs go out round robin so one busy pot can't starve the others.
+//
+// DIN runs at 3125 bytes/s and also carries the MIDI library's thru, the
+// notes and clock coming in. Panel CCs only take what is left over:
+//   - at most MIDIOUT_DIN_BYTES_PER_S, from a token bucket
+//   - only while the UART has nothing else queued, so a note or clock byte
+//     written after a CC waits behind at most one 3 byte message, ~1ms
+// USB has the bandwidth to send every pending CC each loop.
+
+#define MIDIOUT_DIN_BYTES_PER_S 1500  // About half of DIN
+#define MIDIOUT_DIN_BURST 6           // Bucket size, two messages
+#define MIDIOUT_USB_MAX 16            // Per loop
+
+uint8_t midiOutValue[128];
+uint32_t midiOutDinPending[4];
+uint32_t midiOutUsbPending[4];
+uint32_t midiOutSwitch[4];  // CCs of panel buttons, a press is sent as 127
+uint8_t midiOutDinNext = 0;
+uint8_t midiOutUsbNext = 0;
+int midiOutDinIdle = 0;       // availableForWrite() with nothing queued
+uint32_t midiOutTokens = 0;   // Bytes x 1000
+uint32_t midiOutLastMicros = 0;
+
+void midiOutSetup() {
+  for (const ButtonAction &a : buttonActions) {
+    if (a.mode != BTN_NONE) midiOutSwitch[a.cc >> 5] |= 1UL << (a.cc & 31);
+  }
+  midiOutDinIdle = Serial1.availableForWrite();
+  midiOutLastMicros = micros();
+}
+
+// From myControlChange(), value is 0-1023 from a pot. The button CCs act on
+// any value received, so a press always goes out as 127 whatever state the
+// button was left in.
+void midiOutQueue(uint8_t control, int value) {
+  control &= 127;
+  uint32_t bit = 1UL << (control & 31);
+  midiOutValue[control] = (midiOutSwitch[control >> 5] & bit) ? 127 : constrain(value >> 3, 0, 127);
+  midiOutDinPending[control >> 5] |= bit;
+  midiOutUsbPending[control >> 5] |= bit;
+}
+
+// Next pending CC from next on, wrapping, -1 if none. Clears its bit.
+int midiOutTake(uint32_t *pending, uint8_t &next) {
+  for (int n = 0; n < 128;) {
+    int control = (next + n) & 127;
+    uint32_t bits = pending[control >> 5] >> (control & 31);
+    if (bits) {
+      control += __builtin_ctz(bits);
+      pending[control >> 5] &= ~(1UL << (control & 31));
+      next = (control + 1) & 127;
+      return control;
+    }
+    n += 32 - (control & 31);
+  }
+  return -1;
+}
+
+void checkMidiOut() {
+  byte channel = midiChannel == MIDI_CHANNEL_OMNI ? 1 : midiChannel;
+
+  boolean usbSent = false;
+  for (int i = 0; i < MIDIOUT_USB_MAX; i++) {
+    int control = midiOutTake(midiOutUsbPending, midiOutUsbNext);
+    if (control < 0) break;
+    usbMIDI.sendControlChange(control, midiOutValue[control], channel);
+    usbSent = true;
+  }
+  if (usbSent) usbMIDI.send_now();
+
+  uint32_t now = micros();
+  uint32_t elapsed = min(now - midiOutLastMicros, (uint32_t)10000);
+  midiOutTokens += elapsed * MIDIOUT_DIN_BYTES_PER_S / 1000;
+  midiOutLastMicros = now;
+  if (midiOutTokens > MIDIOUT_DIN_BURST * 1000) midiOutTokens = MIDIOUT_DIN_BURST * 1000;
+  if (midiOutTokens < 3000 || Serial1.availableForWrite() < midiOutDinIdle) return;
+
+  int control = midiOutTake(midiOutDinPending, midiOutDinNext);
+  if (control < 0) return;
+  MIDI.sendControlChange(control, midiOutValue[control], channel);
+  midiOutTokens -= 3000;
+}
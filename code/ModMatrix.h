@@ -0,0 +1,236 @@
+// Software modulation matrix
+//
+// A fixed rate IntervalTimer runs two extra LFOs, a looping envelope and a
+// random sample & hold. Each route adds a scaled source onto a destination
+// offset that writeDemux() adds to the panel value before it is sent to the DAC.
+// Demux channels 14 and 15 carry the four raw sources as spare CV outputs.
+//
+// Everything in the ISR is fixed point:
+//   sources  - signed Q15, -32768..32767 (envelope is unipolar 0..32767)
+//   depths   - signed Q15, -1.0..+1.0 of the full pot range
+//   offsets  - 10 bit parameter units, the same scale as the pots (0-1023)
+
+#define MOD_RATE_HZ 1000
+#define MOD_PERIOD_US (1000000 / MOD_RATE_HZ)
+#define MOD_SLOTS 4
+#define MOD_ISR_PRIORITY 192  // Below serial MIDI so incoming bytes are never held off
+
+enum ModSource : uint8_t {
+  MODSRC_NONE,
+  MODSRC_LFO3,
+  MODSRC_LFO4,
+  MODSRC_LOOPENV,
+  MODSRC_SH,
+  MODSRC_COUNT
+};
+
+enum ModDest : uint8_t {
+  MODDST_NONE,
+  MODDST_CUTOFF,
+  MODDST_OSC1PW,
+  MODDST_OSC2PW,
+  MODDST_OSC1LEVEL,
+  MODDST_OSC2LEVEL,
+  MODDST_VOLUME,
+  MODDST_COUNT
+};
+
+enum ModWave : uint8_t {
+  MODWAVE_TRI,
+  MODWAVE_SAW,
+  MODWAVE_SQUARE
+};
+
+struct ModRoute {
+  uint8_t source;
+  uint8_t dest;
+  int16_t depth;  // Q15
+};
+
+// Depths start at zero so the matrix is silent until a depth CC is received.
+// Sources and destinations can be changed on the settings page, "Mod n Src"
+// and "Mod n Dest", and are kept in the settings journal.
+ModRoute modRoutes[MOD_SLOTS] = {
+  { MODSRC_LFO3, MODDST_CUTOFF, 0 },
+  { MODSRC_LFO4, MODDST_OSC1PW, 0 },
+  { MODSRC_LOOPENV, MODDST_OSC2LEVEL, 0 },
+  { MODSRC_SH, MODDST_CUTOFF, 0 }
+};
+
+const char *const MOD_DEPTH_NAMES[MOD_SLOTS] = { "Mod Depth 1", "Mod Depth 2", "Mod Depth 3", "Mod Depth 4" };
+
+IntervalTimer modTimer;
+
+uint32_t modLfoPhase[2] = { 0, 0 };
+volatile uint32_t modLfoInc[2] = { 0, 0 };
+uint8_t modLfoWave[2] = { MODWAVE_TRI, MODWAVE_SQUARE };
+
+enum ModEnvPhase : uint8_t { MODENV_ATTACK, MODENV_DECAY };
+uint8_t modEnvPhase = MODENV_ATTACK;
+int32_t modEnvLevel = 0;
+volatile int32_t modEnvAttackInc = 0;
+volatile int32_t modEnvDecayInc = 0;
+
+uint32_t modShPhase = 0;
+volatile uint32_t modShInc = 0;
+int16_t modShValue = 0;
+uint32_t modRandomState = 0x1234567;
+
+// Written by the ISR, read by writeDemux()
+volatile int16_t modOffset[MODDST_COUNT] = {};
+volatile uint16_t modSpareCode[4] = { 2048, 2048, 0, 2048 };
+
+// CPU budget, in cycles per tick
+volatile uint32_t modIsrCycles = 0;
+volatile uint32_t modIsrMaxCycles = 0;
+volatile uint32_t modIsrAvgCycles = 0;  // Moving average, /8 per tick
+
+inline int16_t modWaveform(uint32_t phase, uint8_t wave) {
+  uint16_t p = phase >> 16;
+  switch (wave) {
+    case MODWAVE_SAW:
+      return (int16_t)((int32_t)p - 32768);
+    case MODWAVE_SQUARE:
+      return p < 0x8000 ? 32767 : -32768;
+    default:
+      if (p < 0x8000) return (int16_t)((int32_t)p * 2 - 32768);
+      return (int16_t)(32767 - (int32_t)(p - 0x8000) * 2);
+  }
+}
+
+inline uint32_t modRandom() {
+  modRandomState ^= modRandomState << 13;
+  modRandomState ^= modRandomState >> 17;
+  modRandomState ^= modRandomState << 5;
+  return modRandomState;
+}
+
+// Q15 bipolar to a 12 bit DAC code centred at 2048
+inline uint16_t modToDac(int16_t v) {
+  return (uint16_t)(((int32_t)v + 32768) >> 4);
+}
+
+void modTick() {
+  uint32_t start = ARM_DWT_CYCCNT;
+  int16_t src[MODSRC_COUNT];
+
+  src[MODSRC_NONE] = 0;
+
+  modLfoPhase[0] += modLfoInc[0];
+  modLfoPhase[1] += modLfoInc[1];
+  src[MODSRC_LFO3] = modWaveform(modLfoPhase[0], modLfoWave[0]);
+  src[MODSRC_LFO4] = modWaveform(modLfoPhase[1], modLfoWave[1]);
+
+  if (modEnvPhase == MODENV_ATTACK) {
+    modEnvLevel += modEnvAttackInc;
+    if (modEnvLevel >= 32767) {
+      modEnvLevel = 32767;
+      modEnvPhase = MODENV_DECAY;
+    }
+  } else {
+    modEnvLevel -= modEnvDecayInc;
+    if (modEnvLevel <= 0) {
+      modEnvLevel = 0;
+      modEnvPhase = MODENV_ATTACK;
+    }
+  }
+  src[MODSRC_LOOPENV] = (int16_t)modEnvLevel;
+
+  uint32_t prevShPhase = modShPhase;
+  modShPhase += modShInc;
+  if (modShPhase < prevShPhase) modShValue = (int16_t)(modRandom() >> 16);
+  src[MODSRC_SH] = modShValue;
+
+  int32_t acc[MODDST_COUNT] = {};
+  for (int i = 0; i < MOD_SLOTS; i++) {
+    const ModRoute &r = modRoutes[i];
+    if (r.depth == 0 || r.dest == MODDST_NONE) continue;
+    // Q15 * Q15 >> 20 leaves +/-1024, i.e. the full 10 bit pot range
+    acc[r.dest] += ((int32_t)src[r.source] * r.depth) >> 20;
+  }
+  for (int d = 0; d < MODDST_COUNT; d++) modOffset[d] = (int16_t)constrain(acc[d], -POT_MAX, POT_MAX);
+
+  modSpareCode[0] = modToDac(src[MODSRC_LFO3]);
+  modSpareCode[1] = modToDac(src[MODSRC_LFO4]);
+  modSpareCode[2] = (uint16_t)(src[MODSRC_LOOPENV] >> 3);  // Unipolar, 0-4095
+  modSpareCode[3] = modToDac(src[MODSRC_SH]);
+
+  uint32_t cycles = ARM_DWT_CYCCNT - start;
+  modIsrCycles = cycles;
+  if (cycles > modIsrMaxCycles) modIsrMaxCycles = cycles;
+  modIsrAvgCycles = modIsrAvgCycles - (modIsrAvgCycles >> 3) + cycles;
+}
+
+// Percentage of the CPU used by the matrix in tenths of a percent
+uint32_t modCpuPermille() {
+  return (uint32_t)(((uint64_t)(modIsrAvgCycles >> 3) * MOD_RATE_HZ * 1000) / F_CPU);
+}
+
+// Panel value plus modulation, clamped to the pot range
+inline int modApply(int value, uint8_t dest) {
+  return constrain(value + modOffset[dest], 0, POT_MAX);
+}
+
+// 0.05Hz to 50Hz, exponential over the pot range
+uint32_t modRateToInc(int value) {
+  float hz = 0.05f * powf(1000.0f, (float)constrain(value, 0, POT_MAX) / (float)POT_MAX);
+  return (uint32_t)(hz * (4294967296.0f / MOD_RATE_HZ));
+}
+
+void modSetLfoRate(uint8_t lfo, int value) {
+  modLfoInc[lfo] = modRateToInc(value);
+}
+
+void modSetShRate(int value) {
+  modShInc = modRateToInc(value);
+}
+
+// Loop period 2ms to 10s, 10% attack and 90% decay
+void modSetEnvRate(int value) {
+  float ms = 2.0f * powf(5000.0f, (float)(POT_MAX - constrain(value, 0, POT_MAX)) / (float)POT_MAX);
+  float ticks = ms * (MOD_RATE_HZ / 1000.0f);
+  modEnvAttackInc = max((int32_t)(32767.0f / (ticks * 0.1f)), (int32_t)1);
+  modEnvDecayInc = max((int32_t)(32767.0f / (ticks * 0.9f)), (int32_t)1);
+}
+
+// 0-1023 from a pot or CC, centre is zero depth
+void modSetDepth(uint8_t slot, int value) {
+  if (slot >= MOD_SLOTS) return;
+  modRoutes[slot].depth = (int16_t)constrain((value - 512) * 64, -32768, 32767);
+}
+
+void modSetRoute(uint8_t slot, uint8_t source, uint8_t dest, int16_t depth) {
+  if (slot >= MOD_SLOTS || source >= MODSRC_COUNT || dest >= MODDST_COUNT) return;
+  modRoutes[slot].depth = 0;  // Silence the slot while it is rewired
+  modRoutes[slot].source = source;
+  modRoutes[slot].dest = dest;
+  modRoutes[slot].depth = depth;
+}
+
+// Source or destination from the settings page, the other is kept
+void modEditRoute(uint8_t slot, int source, int dest) {
+  if (slot >= MOD_SLOTS) return;
+  if (source < 0) source = modRoutes[slot].source;
+  if (dest < 0) dest = modRoutes[slot].dest;
+  modSetRoute(slot, source, dest, modRoutes[slot].depth);
+  storeModRoute(slot, 0x80 | modRoutes[slot].source << 4 | modRoutes[slot].dest);
+}
+
+void modSetup() {
+  for (uint8_t slot = 0; slot < MOD_SLOTS; slot++) {
+    int route = getModRoute(slot);
+    if (route & 0x80) modSetRoute(slot, (route >> 4) & 7, route & 15, 0);
+  }
+
+  //Cycle counter for the CPU budget
+  ARM_DEMCR |= ARM_DEMCR_TRCENA;
+  ARM_DWT_CTRL |= ARM_DWT_CTRL_CYCCNTENA;
+
+  modSetLfoRate(0, 400);
+  modSetLfoRate(1, 300);
+  modSetEnvRate(500);
+  modSetShRate(500);
+
+  modTimer.begin(modTick, MOD_PERIOD_US);
+  modTimer.priority(MOD_ISR_PRIORITY);
+}
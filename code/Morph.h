@@ -0,0 +1,105 @@
+// Patch morphing
+//
+// A morph loads the target patch as usual, so switches and routing change at
+// once, but the continuous parameters are put back to where they were and
+// then moved to the target by an IntervalTimer at MORPH_RATE_HZ. Each tick is
+// one Q15 lerp per parameter written straight into the globals writeDemux()
+// sends to the DAC, so the cost per tick is fixed and measured below.
+//
+// The position either runs over the "Morph Time" setting or follows the mod
+// wheel / CCmorphPosition.
+
+#define MORPH_RATE_HZ 250
+#define MORPH_ONE 32768  // Q15 position at the target
+#define MORPH_ISR_PRIORITY 208
+#define MORPH_MANUAL 5   // "Morph Time" index for Mod Wheel
+
+enum PatchLoad : uint8_t {
+  LOAD_RECALL,
+  LOAD_BROWSE,
+  LOAD_MORPH
+};
+
+// Defined in Source.ino
+bool loadPatch(int patchNo, PatchLoad load);
+
+// The continuous patch fields, volume included so the level glides too
+int16_t *const MORPH_PARAMS[] = {
+  &volume, &filterCutoff, &filterRes, &filterLevel,
+  &filterAttack, &filterDecay, &filterSustain, &filterRelease,
+  &ampAttack, &ampDecay, &ampSustain, &ampRelease,
+  &osc1level, &osc2level, &osc1PW, &osc2PW, &osc1PWM, &osc2PWM,
+  &osc2interval, &osc1foot, &osc2foot,
+  &noiseLevel, &glide, &LfoRate, &pwLFO
+};
+#define MORPH_PARAM_COUNT (sizeof(MORPH_PARAMS) / sizeof(MORPH_PARAMS[0]))
+
+const uint16_t MORPH_TIMES_MS[] = { 500, 1000, 2000, 5000, 10000 };
+
+int morphTimeIndex = 1;  //(EEPROM)
+
+IntervalTimer morphTimer;
+int16_t morphFrom[MORPH_PARAM_COUNT];
+int16_t morphDelta[MORPH_PARAM_COUNT];
+volatile boolean morphActive = false;
+volatile int32_t morphPos = 0;   // Q15
+volatile int32_t morphStep = 0;  // Per tick, 0 when following the mod wheel
+
+// Per tick, in cycles
+volatile uint32_t morphTickCycles = 0;
+volatile uint32_t morphTickMaxCycles = 0;
+
+void morphStop() {
+  morphTimer.end();
+  morphActive = false;
+}
+
+void morphTick() {
+  uint32_t start = ARM_DWT_CYCCNT;
+  int32_t pos = morphPos + morphStep;
+  if (pos >= MORPH_ONE) pos = MORPH_ONE;
+  morphPos = pos;
+
+  for (unsigned int i = 0; i < MORPH_PARAM_COUNT; i++) {
+    *MORPH_PARAMS[i] = morphFrom[i] + (((int32_t)morphDelta[i] * pos) >> 15);
+  }
+
+  if (pos == MORPH_ONE) morphStop();
+
+  uint32_t cycles = ARM_DWT_CYCCNT - start;
+  morphTickCycles = cycles;
+  if (cycles > morphTickMaxCycles) morphTickMaxCycles = cycles;
+}
+
+// Called by loadPatch() with the target patch applied, before the patch
+// transaction commits. The parameters go back to the start values so the
+// DAC never sees the jump.
+void morphCapture() {
+  for (unsigned int i = 0; i < MORPH_PARAM_COUNT; i++) {
+    morphDelta[i] = *MORPH_PARAMS[i] - morphFrom[i];
+    *MORPH_PARAMS[i] = morphFrom[i];
+  }
+}
+
+void morphStart(int patchNo) {
+  morphStop();
+  for (unsigned int i = 0; i < MORPH_PARAM_COUNT; i++) morphFrom[i] = *MORPH_PARAMS[i];
+  if (!loadPatch(patchNo, LOAD_MORPH)) return;
+
+  morphPos = 0;
+  if (morphTimeIndex == MORPH_MANUAL) {
+    morphStep = 0;
+  } else {
+    uint32_t ticks = (uint32_t)MORPH_TIMES_MS[morphTimeIndex] * MORPH_RATE_HZ / 1000;
+    morphStep = max((int32_t)(MORPH_ONE / ticks), (int32_t)1);
+  }
+  morphActive = true;
+  morphTimer.begin(morphTick, 1000000 / MORPH_RATE_HZ);
+  morphTimer.priority(MORPH_ISR_PRIORITY);
+}
+
+// 0-1023 from the mod wheel or CCmorphPosition, only while following
+void morphSetPosition(int value) {
+  if (!morphActive || morphStep) return;
+  morphPos = (int32_t)constrain(value, 0, POT_MAX) * MORPH_ONE / POT_MAX;
+}
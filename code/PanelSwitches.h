@@ -0,0 +1,227 @@
+// Panel switch scanning
+//
+// The six 74HC165s are read in one burst into a 48 bit word, bit n is button
+// n in HWControls.h (same order and active low wiring the RoxOctoswitch
+// library used). The new word is XORed against the last accepted state, so a
+// scan with nothing pressed or released costs one compare.
+//
+// A change is taken on its first edge and the button is then ignored for
+// SWITCH_LOCKOUT_MS, which swallows contact bounce without adding the
+// debounce time to the response.
+//
+// Events go through buttonActions[], indexed by button number.
+
+//#define SWITCH_TIMING_REPORT
+
+#define SWITCH_COUNT 48
+#define SWITCH_LOCKOUT_MS 30
+#define SWITCH_HOLD_MS 750
+#define SWITCH_DOUBLE_MS 300
+
+enum SwitchEvent : uint8_t {
+  SW_PRESS,
+  SW_RELEASE,
+  SW_HOLD,
+  SW_DOUBLE
+};
+
+enum ButtonMode : uint8_t {
+  BTN_NONE,
+  BTN_TOGGLE,  // var = !var on press
+  BTN_SELECT,  // var = 1 and partner = 0 on press
+};
+
+typedef void (*ButtonHandler)(uint8_t button);
+
+struct ButtonAction {
+  uint8_t cc;
+  ButtonMode mode;
+  uint8_t *var;
+  uint8_t *partner;
+  ButtonHandler onHold;
+  ButtonHandler onDouble;
+};
+
+// Defined in Source.ino
+void myControlChange(byte channel, byte control, int value);
+// MidiLearn.h
+void midiLearnArm(uint8_t control);
+boolean midiLearnCancel();
+extern uint8_t ccLearnTarget;
+
+constexpr ButtonAction BTN_UNUSED = { 0, BTN_NONE, nullptr, nullptr, nullptr, nullptr };
+
+constexpr ButtonAction toggleButton(uint8_t cc, uint8_t *var) {
+  return { cc, BTN_TOGGLE, var, nullptr, nullptr, nullptr };
+}
+
+constexpr ButtonAction selectButton(uint8_t cc, uint8_t *var, uint8_t *partner) {
+  return { cc, BTN_SELECT, var, partner, nullptr, nullptr };
+}
+
+// LFO to OSC/VCF have an off and an on button that both toggle
+constexpr ButtonAction buttonActions[SWITCH_COUNT] = {
+  toggleButton(CCosc1_32, &osc1_32switch),          // OSC1_32 0
+  toggleButton(CCosc1_16, &osc1_16switch),          // OSC1_16 1
+  toggleButton(CCosc1_8, &osc1_8switch),            // OSC1_8 2
+  toggleButton(CCosc1_saw, &osc1_sawswitch),        // OSC1_SAW 3
+  toggleButton(CCosc1_tri, &osc1_triswitch),        // OSC1_TRI 4
+  toggleButton(CCosc1_pulse, &osc1_pulseswitch),    // OSC1_PULSE 5
+  BTN_UNUSED,
+  BTN_UNUSED,
+  selectButton(CCsingle, &singleswitch, &multiswitch),   // SINGLE_TRIG 8
+  selectButton(CCmulti, &multiswitch, &singleswitch),    // MULTIPLE_TRIG 9
+  toggleButton(CClfoTriangle, &lfoTriangleswitch),  // LFO_TRIANGLE 10
+  toggleButton(CClfoSquare, &lfoSquareswitch),      // LFO_SQUARE 11
+  selectButton(CCsyncOff, &syncOffswitch, &syncOnswitch),  // SYNC_OFF 12
+  selectButton(CCsyncOn, &syncOnswitch, &syncOffswitch),   // SYNC_ON 13
+  toggleButton(CCoctave0, &octave0switch),          // OCTAVE_0 14
+  toggleButton(CCoctave1, &octave1switch),          // OCTAVE_1 15
+  toggleButton(CCkbOff, &kbOffswitch),              // KB_OFF 16
+  toggleButton(CCkbHalf, &kbHalfswitch),            // KB_HALF 17
+  toggleButton(CCkbFull, &kbFullswitch),            // KB_FULL 18
+  toggleButton(CCosc2_8, &osc2_8switch),            // OSC2_8 19
+  toggleButton(CCosc2_saw, &osc2_sawswitch),        // OSC2_SAW 20
+  toggleButton(CCosc2_tri, &osc2_triswitch),        // OSC2_TRI 21
+  toggleButton(CCosc2_pulse, &osc2_pulseswitch),    // OSC2_PULSE 22
+  BTN_UNUSED,
+  toggleButton(CClfoOscOn, &lfoOscOnswitch),        // LFO_OSC_OFF 24
+  toggleButton(CClfoOscOn, &lfoOscOnswitch),        // LFO_OSC_ON 25
+  toggleButton(CCosc2_32, &osc2_32switch),          // OSC2_32 26
+  toggleButton(CCosc2_16, &osc2_16switch),          // OSC2_16 27
+  toggleButton(CClevel1, &level1switch),            // LEVEL1 28
+  toggleButton(CClevel2, &level2switch),            // LEVEL2 29
+  toggleButton(CClfoVCFOn, &lfoVCFOnswitch),        // LFO_VCF_OFF 30
+  toggleButton(CClfoVCFOn, &lfoVCFOnswitch),        // LFO_VCF_ON 31
+  toggleButton(CCbutton1, &button1switch),          // BUTTON1 32
+  toggleButton(CCbutton2, &button2switch),
+  toggleButton(CCbutton3, &button3switch),
+  toggleButton(CCbutton4, &button4switch),
+  toggleButton(CCbutton5, &button5switch),
+  toggleButton(CCbutton6, &button6switch),
+  toggleButton(CCbutton7, &button7switch),
+  toggleButton(CCbutton8, &button8switch),
+  toggleButton(CCbutton9, &button9switch),
+  toggleButton(CCbutton10, &button10switch),
+  toggleButton(CCbutton11, &button11switch),
+  toggleButton(CCbutton12, &button12switch),
+  toggleButton(CCbutton13, &button13switch),
+  toggleButton(CCbutton14, &button14switch),
+  toggleButton(CCbutton15, &button15switch),
+  toggleButton(CCbutton16, &button16switch),        // BUTTON16 47
+};
+
+uint8_t swDataPin, swLoadPin, swClkPin;
+
+uint64_t swState = 0;      // Accepted state, 1 = pressed
+uint64_t swHoldSent = 0;   // Pressed buttons that have already sent SW_HOLD
+uint32_t swChangedAt[SWITCH_COUNT] = {};
+uint32_t swLastPressAt[SWITCH_COUNT] = {};
+
+// Scan to action, in cycles
+uint32_t swLatencyCycles = 0;
+uint32_t swLatencyMaxCycles = 0;
+
+void switchScanBegin(uint8_t dataPin, uint8_t loadPin, uint8_t clkPin) {
+  swDataPin = dataPin;
+  swLoadPin = loadPin;
+  swClkPin = clkPin;
+  pinMode(swDataPin, INPUT);
+  pinMode(swLoadPin, OUTPUT);
+  pinMode(swClkPin, OUTPUT);
+  digitalWriteFast(swLoadPin, HIGH);
+  digitalWriteFast(swClkPin, LOW);
+}
+
+uint64_t readSwitches() {
+  digitalWriteFast(swLoadPin, LOW);
+  delayMicroseconds(1);
+  digitalWriteFast(swLoadPin, HIGH);
+
+  uint64_t pressed = 0;
+  for (int chip = 0; chip < SWITCH_COUNT / 8; chip++) {
+    for (int pin = 7; pin >= 0; pin--) {
+      if (digitalReadFast(swDataPin) == LOW) pressed |= 1ULL << (chip * 8 + pin);
+      digitalWriteFast(swClkPin, HIGH);
+      delayNanoseconds(100);
+      digitalWriteFast(swClkPin, LOW);
+    }
+  }
+  return pressed;
+}
+
+void buttonEvent(uint8_t button, SwitchEvent event) {
+  const ButtonAction &a = buttonActions[button];
+  switch (event) {
+    case SW_PRESS:
+      if (a.mode != BTN_NONE && a.cc == ccLearnTarget) {
+        midiLearnCancel();  // Pressed again while armed
+      } else if (a.mode == BTN_TOGGLE) {
+        *a.var = !*a.var;
+        myControlChange(midiChannel, a.cc, *a.var);
+      } else if (a.mode == BTN_SELECT) {
+        *a.var = 1;
+        *a.partner = 0;
+        myControlChange(midiChannel, a.cc, *a.var);
+      }
+      break;
+    case SW_HOLD:
+      if (a.onHold) a.onHold(button);
+      else if (a.mode != BTN_NONE) midiLearnArm(a.cc);  // Hold to learn
+      break;
+    case SW_DOUBLE:
+      if (a.onDouble) a.onDouble(button);
+      break;
+    case SW_RELEASE:
+      break;
+  }
+}
+
+void checkPanelSwitches() {
+  uint32_t start = ARM_DWT_CYCCNT;
+  uint32_t now = millis();
+  uint64_t raw = readSwitches();
+  uint64_t changed = raw ^ swState;
+
+  while (changed) {
+    uint8_t b = __builtin_ctzll(changed);
+    uint64_t bit = 1ULL << b;
+    changed &= ~bit;
+    if (now - swChangedAt[b] < SWITCH_LOCKOUT_MS) continue;
+    swChangedAt[b] = now;
+    swState ^= bit;
+    if (raw & bit) {
+      swHoldSent &= ~bit;
+      bool dbl = (now - swLastPressAt[b]) < SWITCH_DOUBLE_MS;
+      swLastPressAt[b] = dbl ? 0 : now;  // A third press starts a new pair
+      buttonEvent(b, SW_PRESS);
+      if (dbl) buttonEvent(b, SW_DOUBLE);
+    } else {
+      buttonEvent(b, SW_RELEASE);
+    }
+    swLatencyCycles = ARM_DWT_CYCCNT - start;
+    if (swLatencyCycles > swLatencyMaxCycles) swLatencyMaxCycles = swLatencyCycles;
+  }
+
+  uint64_t holding = swState & ~swHoldSent;
+  while (holding) {
+    uint8_t b = __builtin_ctzll(holding);
+    uint64_t bit = 1ULL << b;
+    holding &= ~bit;
+    if (now - swChangedAt[b] >= SWITCH_HOLD_MS) {
+      swHoldSent |= bit;
+      buttonEvent(b, SW_HOLD);
+    }
+  }
+
+#ifdef SWITCH_TIMING_REPORT
+  static elapsedMillis reportTimer;
+  if (reportTimer >= 5000) {
+    reportTimer = 0;
+    Serial.print("Switch scan to action us last:");
+    Serial.print(swLatencyCycles / (F_CPU / 1000000));
+    Serial.print(" max:");
+    Serial.println(swLatencyMaxCycles / (F_CPU / 1000000));
+  }
+#endif
+}
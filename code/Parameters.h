@@ -11,15 +11,11 @@ constexpr int DETUNE_END = POT_MAX / 4;
 
 int offset;
 
-int modWheelDepth = 0;
-int pitchBendRange = 0;
-int afterTouchDepth = 0;
 int bended = 1024;
-int keyMode = 0;
 static unsigned long clock_timer = 0, clock_timeout = 0;
 static unsigned int clock_count = 0;
-int clocksource = 0;
 int oldclocksource = 0;
+boolean patchSyncGate = false;  //(EEPROM) Patch changes wait for the gate to close
 int oldnote = 0;
 
 constexpr uint8_t MAX_ARP_STEPS = 24;
@@ -36,8 +32,9 @@ uint8_t firstArpNote = 0;
 bool firstNoteSet = false;
 
 elapsedMicros arpTimer;
+IntervalTimer arpGateTimer;      // gate off when clocked externally
 
-uint32_t arpStepMicros = 250000;   // derived from LFO
+uint32_t arpStepMicros = 250000;   // derived from LFO or external clock
 uint32_t arpGateMicros = 200000;   // ~80%
 
 enum ArpPhase {
@@ -48,14 +45,36 @@ enum ArpPhase {
 ArpPhase arpPhase = ARP_GATE_OFF;
 
 constexpr uint8_t SEQ_MAX_STEPS = 64;
-constexpr uint8_t SEQ_REST = 255;
+constexpr uint8_t SEQ_REST = 255;          // rest marker in the old CSV sequence format
+constexpr uint8_t SEQ_DEFAULT_GATE = 102;  // ~80% of the step
+constexpr uint8_t SEQ_DEFAULT_VELOCITY = 100;
+constexpr uint8_t SEQ_ACCENT_BOOST = 32;
+constexpr int SEQ_SLIDE_GLIDE = 200;       // minimum glide while sliding between steps
+
+// One step packed into 32 bits
+struct SeqStep {
+  uint32_t note : 7;
+  uint32_t rest : 1;
+  uint32_t tie : 1;       // hold the gate into the next step
+  uint32_t slide : 1;     // hold the gate and glide into the next step
+  uint32_t accent : 1;
+  uint32_t velocity : 7;
+  uint32_t gate : 7;      // gate length in 1/128ths of the step
+  int32_t micro : 7;      // timing offset in 1/256ths of the step, -64..63
+};
+static_assert(sizeof(SeqStep) == 4, "SeqStep must pack into 32 bits");
 
 struct StepSeq {
-  uint8_t steps[SEQ_MAX_STEPS];
+  SeqStep steps[SEQ_MAX_STEPS];
   uint8_t length = 0;      // number of recorded steps
   uint8_t index  = 0;      // playback position
 };
 
+// Compact sequence encoding, see seqEncode()
+constexpr size_t SEQ_ENCODED_MAX = 1 + SEQ_MAX_STEPS * 5;
+constexpr size_t SEQ_FIELD_MAX = 2 + ((SEQ_ENCODED_MAX + 2) / 3) * 4;
+constexpr char SEQ_COMPACT_TAG = 'q';
+
 StepSeq seq1, seq2;
 
 bool seqEnabled = false;
@@ -66,187 +85,200 @@ SeqRunState seqState = SEQ_IDLE;
 uint8_t recordTarget = 0;     // 0 = none, 1 = seq1, 2 = seq2
 uint8_t playTarget   = 0;     // 0 = none, 1 = seq1, 2 = seq2
 
-elapsedMicros seqTimer;
+// Playback runs from timers so step starts and gate lengths don't depend on loop() timing
+IntervalTimer seqStepTimer;
+IntervalTimer seqGateTimer;
+volatile bool seqHeld = false;       // gate held over from a tied or sliding step
+volatile bool seqSlideGlide = false;
 
 uint32_t seqStepMicros = 250000;
-uint32_t seqGateMicros = 200000;
 
-enum SeqPhase { SEQ_GATE_OFF, SEQ_GATE_ON };
-SeqPhase seqPhase = SEQ_GATE_OFF;
+// Patch schema: PATCH_FIELDS in PatchFields.h
+
+// Patch state
+//
+// The schema fields in one block. The old global names are references into
+// it so the rest of the code is unchanged, and the display values (the
+// ...str globals) stay outside.
+//
+// A copy is a memcpy and comparing two is a word compare, see
+// patchSnapshot() / patchEdited(). patchStored and patchUndo are the compare
+// and undo buffers, sizeof(PatchState) each.
+#define PATCH_MEMBER(type, name, lo, hi, def, since) type name = def;
+struct alignas(4) PatchState {
+  PATCH_FIELDS(PATCH_MEMBER)
+  uint8_t version = PATCH_STATE_VERSION;
+};
+#undef PATCH_MEMBER
+static_assert(sizeof(PatchState) % 4 == 0, "PatchState is compared a word at a time");
+
+#define PATCH_CHECK(type, name, lo, hi, def, since) \
+  static_assert((lo) <= (def) && (def) <= (hi), #name " default outside its range"); \
+  static_assert((type)(lo) == (lo) && (type)(hi) == (hi), #name " range doesn't fit its type"); \
+  static_assert((since) >= 1 && (since) <= PATCH_STATE_VERSION, #name " version");
+PATCH_FIELDS(PATCH_CHECK)
+#undef PATCH_CHECK
+
+// PF_name is the field's position after the patch name
+#define PATCH_INDEX(type, name, lo, hi, def, since) PF_##name,
+enum PatchField : uint8_t {
+  PATCH_FIELDS(PATCH_INDEX)
+  PATCH_FIELD_COUNT
+};
+#undef PATCH_INDEX
+
+#define PATCH_SINCE(type, name, lo, hi, def, since) since,
+constexpr uint8_t PATCH_FIELD_SINCE[] = { PATCH_FIELDS(PATCH_SINCE) };
+#undef PATCH_SINCE
+
+constexpr bool patchFieldsAppendOnly(int i = 1) {
+  return i >= PATCH_FIELD_COUNT || (PATCH_FIELD_SINCE[i - 1] <= PATCH_FIELD_SINCE[i] && patchFieldsAppendOnly(i + 1));
+}
+static_assert(patchFieldsAppendOnly(), "New patch fields go on the end of PATCH_FIELDS");
+
+PatchState patch;
+PatchState patchStored;  // As last loaded or saved
+PatchState patchUndo;    // Before the last load
+PatchState patchPending; // Loaded while a note holds the old sound, see checkPatchTx()
+boolean patchComparing = false;  // patch and patchStored are swapped
+
+#define PATCH_REF(type, name, lo, hi, def, since) type &name = patch.name;
+PATCH_FIELDS(PATCH_REF)
+#undef PATCH_REF
+
+// Field access by PF_ position, for anything that walks the fields
+int patchFieldGet(const PatchState &state, uint8_t field) {
+  switch (field) {
+#define PATCH_GET(type, name, lo, hi, def, since) \
+  case PF_##name: return state.name;
+    PATCH_FIELDS(PATCH_GET)
+#undef PATCH_GET
+  }
+  return 0;
+}
+
+// Clamped to the field's range
+void patchFieldSet(PatchState &state, uint8_t field, int value) {
+  switch (field) {
+#define PATCH_SET(type, name, lo, hi, def, since) \
+  case PF_##name: state.name = (type)constrain(value, (lo), (hi)); break;
+    PATCH_FIELDS(PATCH_SET)
+#undef PATCH_SET
+  }
+}
 
-int noiseLevel = 0;
 int noiseLevelstr = 0; // for display
-int glide = 0;
 int glidestr = 0; // for display
 
-float volume = 0;
 float volumestr = 0; // for display
 
-int osc1_32 = 0;
-int osc1_32switch = 0;
-int osc1_16 = 0;
-int osc1_16switch = 0;
-int osc1_8 = 0;
-int osc1_8switch = 0;
-
-int osc1_saw = 0;
-int osc1_sawswitch = 0;
-int osc1_tri = 0;
-int osc1_triswitch = 0;
-int osc1_pulse = 0;
-int osc1_pulseswitch = 0;
-
-int osc2_32 = 0;
-int osc2_32switch = 0;
-int osc2_16 = 0;
-int osc2_16switch = 0;
-int osc2_8 = 0;
-int osc2_8switch = 0;
-
-int osc2_saw = 0;
-int osc2_sawswitch = 0;
-int osc2_tri = 0;
-int osc2_triswitch = 0;
-int osc2_pulse = 0;
-int osc2_pulseswitch = 0;
-
-int single;
-int singleswitch = 0;
+uint8_t osc1_32switch = 0;
+uint8_t osc1_16switch = 0;
+uint8_t osc1_8switch = 0;
+
+uint8_t osc1_sawswitch = 0;
+uint8_t osc1_triswitch = 0;
+uint8_t osc1_pulseswitch = 0;
+
+uint8_t osc2_32switch = 0;
+uint8_t osc2_16switch = 0;
+uint8_t osc2_8switch = 0;
+
+uint8_t osc2_sawswitch = 0;
+uint8_t osc2_triswitch = 0;
+uint8_t osc2_pulseswitch = 0;
+
 int multi;
-int multiswitch = 0;
 int gatepulse;
 
-int lfoTriangle = 0;
-int lfoTriangleswitch = 0;
-int lfoSquare = 0;
-int lfoSquareswitch = 0;
+uint8_t lfoTriangleswitch = 0;
+uint8_t lfoSquareswitch = 0;
 int lfoOscOff = 0;
-int lfoOscOffswitch = 0;
 int lfoOscOn = 0;
-int lfoOscOnswitch = 0;
 int lfoVCFOff = 0;
-int lfoVCFOffswitch = 0;
 int lfoVCFOn = 0;
-int lfoVCFOnswitch = 0;
 
-int syncOff = 0;
-int syncOffswitch = 0;
-int syncOn = 0;
-int syncOnswitch = 0;
+uint8_t syncOffswitch = 0;
+uint8_t syncOnswitch = 0;
 
 int level1 = 1;
-int level1switch = 0;
+uint8_t level1switch = 0;
 int level2 = 0;
-int level2switch = 0;
+uint8_t level2switch = 0;
 
 
-int octave0 = 0;
-int octave0switch = 0;
-int octave1 = 0;
-int octave1switch = 0;
+uint8_t octave0switch = 0;
+uint8_t octave1switch = 0;
 
-int kbOff = 0;
-int kbOffswitch = 0;
-int kbHalf = 0;
-int kbHalfswitch = 0;
-int kbFull = 0;
-int kbFullswitch = 0;
+uint8_t kbOffswitch = 0;
+uint8_t kbHalfswitch = 0;
+uint8_t kbFullswitch = 0;
 
 int lfoVCO = 0;
 int lfoVCF = 0;
 
 int button1 = 0;
-int button1switch = 0;
+uint8_t button1switch = 0;
 int button2 = 0;
-int button2switch = 0;
+uint8_t button2switch = 0;
 int button3 = 0;
-int button3switch = 0;
-int vcfVelocity = 0;
+uint8_t button3switch = 0;
 int button4 = 0;
-int button4switch = 0;
-int vcaVelocity = 0;
+uint8_t button4switch = 0;
 int button5 = 0;
-int button5switch = 0;
-int vcfLoop= 0;
+uint8_t button5switch = 0;
 int button6 = 0;
-int button6switch = 0;
-int vcaLoop = 0;
+uint8_t button6switch = 0;
 int button7 = 0;
-int button7switch = 0;
-int vcfLinear = 0;
+uint8_t button7switch = 0;
 int button8 = 0;
-int button8switch = 0;
-int vcaLinear = 0;
+uint8_t button8switch = 0;
 
 int button9 = 0;
-int button9switch = 0;
+uint8_t button9switch = 0;
 int button10 = 0;
-int button10switch = 0;
-int shvco = 0;
+uint8_t button10switch = 0;
 int button11 = 0;
-int button11switch = 0;
-int shvcf = 0;
+uint8_t button11switch = 0;
 int button12 = 0;
-int button12switch = 0;
+uint8_t button12switch = 0;
 int button13 = 0;
-int button13switch = 0;
+uint8_t button13switch = 0;
 int button14 = 0;
-int button14switch = 0;
+uint8_t button14switch = 0;
 int button15 = 0;
-int button15switch = 0;
+uint8_t button15switch = 0;
 int button16 = 0;
-int button16switch = 0;
+uint8_t button16switch = 0;
 
 int returnvalue = 0;
 
-int LfoRate = 0;
 float LfoRatestr = 0; //for display
 int LfoWave = 0;
 int LfoWavestr = 0; //for display
-int pwLFO = 0;
 float pwLFOstr = 0; // for display
 
-int osc2level = 0; // for display
 int osc2levelstr = 0;
 int osc1levelstr = 0; //for display
-int osc1level = 0;
 
-int osc1foot = 0;
-int osc2foot = 0;
 
-int osc1PW = 0;
 int osc1PWstr = 0;
-int osc2PW = 0;
 int osc2PWstr = 0;
-int osc2PWM = 0;
 int osc2PWMstr = 0;
-int osc1PWM = 0;
 int osc1PWMstr = 0;
 
-int ampAttack = 0;
 int ampAttackstr = 0;
-int ampDecay = 0;
 int ampDecaystr = 0;
-int ampSustain = 0;
 int ampSustainstr = 0;
-int ampRelease = 0;
 int ampReleasestr = 0;
 
-int osc2interval = 0;
 int osc2intervalstr = 0;
 
-int filterAttack = 0;
 int filterAttackstr = 0;
-int filterDecay = 0;
 int filterDecaystr = 0;
-int filterSustain = 0;
 int filterSustainstr = 0;
-int filterRelease = 0;
 int filterReleasestr = 0;
 
-int filterRes = 0;
 int filterResstr = 0;
-int filterCutoff = 12000;
 float filterCutoffstr = 12000; // for display
-int filterLevel = 0;
 int filterLevelstr = 0;
@@ -0,0 +1,86 @@
+// Patch schema
+//
+// One line per patch file field after the name, in file order:
+//
+//   X(type, name, min, max, default, since)
+//
+// The PatchState struct, the global names, reading, writing and range
+// clamping are all generated from this list. since is the schema version
+// that added the field; fields only ever go on the end. Files carry their
+// version as a "v<n>" field after the name (none means version 1), and
+// fields newer than the file are not read but take their defaults, so the
+// sequences that follow the fields in the file are still found in place.
+// Limits may use POT_MAX (Parameters.h), the list only expands where used.
+// tools/patchreader_test.cpp builds the list on a PC.
+//
+// Version 1 is every file written before the version field, all 65 fields
+// below through afterTouchDepth. Version 2 only adds the "v2" field itself,
+// the field list is unchanged. A field added later takes the next version.
+#define PATCH_STATE_VERSION 2
+
+#define PATCH_FIELDS(X) \
+  X(int16_t, noiseLevel, 0, POT_MAX, 0, 1) \
+  X(int16_t, glide, 0, POT_MAX, 0, 1) \
+  X(uint8_t, osc1_32, 0, 1, 0, 1) \
+  X(uint8_t, osc1_16, 0, 1, 0, 1) \
+  X(uint8_t, osc1_8, 0, 1, 0, 1) \
+  X(uint8_t, osc1_saw, 0, 1, 0, 1) \
+  X(uint8_t, osc1_tri, 0, 1, 0, 1) \
+  X(uint8_t, osc1_pulse, 0, 1, 0, 1) \
+  X(uint8_t, osc2_32, 0, 1, 0, 1) \
+  X(uint8_t, osc2_16, 0, 1, 0, 1) \
+  X(uint8_t, osc2_8, 0, 1, 0, 1) \
+  X(uint8_t, osc2_saw, 0, 1, 0, 1) \
+  X(uint8_t, osc2_tri, 0, 1, 0, 1) \
+  X(uint8_t, osc2_pulse, 0, 1, 0, 1) \
+  X(uint8_t, singleswitch, 0, 1, 0, 1) \
+  X(uint8_t, multiswitch, 0, 1, 0, 1) \
+  X(uint8_t, lfoTriangle, 0, 1, 0, 1) \
+  X(uint8_t, lfoSquare, 0, 1, 0, 1) \
+  X(uint8_t, lfoOscOffswitch, 0, 1, 0, 1) \
+  X(uint8_t, lfoOscOnswitch, 0, 1, 0, 1) \
+  X(uint8_t, lfoVCFOffswitch, 0, 1, 0, 1) \
+  X(uint8_t, lfoVCFOnswitch, 0, 1, 0, 1) \
+  X(uint8_t, syncOff, 0, 1, 0, 1) \
+  X(uint8_t, syncOn, 0, 1, 0, 1) \
+  X(uint8_t, kbOff, 0, 1, 0, 1) \
+  X(uint8_t, kbHalf, 0, 1, 0, 1) \
+  X(uint8_t, kbFull, 0, 1, 0, 1) \
+  X(int16_t, LfoRate, 0, POT_MAX, 0, 1) \
+  X(int16_t, pwLFO, 0, POT_MAX, 0, 1) \
+  X(int16_t, osc1level, 0, POT_MAX, 0, 1) \
+  X(int16_t, osc2level, 0, POT_MAX, 0, 1) \
+  X(int16_t, osc1PW, 0, POT_MAX, 0, 1) \
+  X(int16_t, osc2PW, 0, POT_MAX, 0, 1) \
+  X(int16_t, osc1PWM, 0, POT_MAX, 0, 1) \
+  X(int16_t, osc2PWM, 0, POT_MAX, 0, 1) \
+  X(int16_t, ampAttack, 0, POT_MAX, 0, 1) \
+  X(int16_t, ampDecay, 0, POT_MAX, 0, 1) \
+  X(int16_t, ampSustain, 0, POT_MAX, 0, 1) \
+  X(int16_t, ampRelease, 0, POT_MAX, 0, 1) \
+  X(int16_t, osc2interval, 0, POT_MAX, 0, 1) \
+  X(int16_t, filterAttack, 0, POT_MAX, 0, 1) \
+  X(int16_t, filterDecay, 0, POT_MAX, 0, 1) \
+  X(int16_t, filterSustain, 0, POT_MAX, 0, 1) \
+  X(int16_t, filterRelease, 0, POT_MAX, 0, 1) \
+  X(int16_t, filterRes, 0, POT_MAX, 0, 1) \
+  X(int16_t, filterCutoff, 0, POT_MAX, POT_MAX, 1) \
+  X(int16_t, filterLevel, 0, POT_MAX, 0, 1) \
+  X(int16_t, osc1foot, 0, 4095, 0, 1) \
+  X(int16_t, osc2foot, 0, 4095, 0, 1) \
+  X(uint8_t, octave0, 0, 1, 0, 1) \
+  X(uint8_t, octave1, 0, 1, 0, 1) \
+  X(uint8_t, shvco, 0, 1, 0, 1) \
+  X(uint8_t, shvcf, 0, 1, 0, 1) \
+  X(uint8_t, vcfVelocity, 0, 1, 0, 1) \
+  X(uint8_t, vcaVelocity, 0, 1, 0, 1) \
+  X(uint8_t, vcfLoop, 0, 1, 0, 1) \
+  X(uint8_t, vcaLoop, 0, 1, 0, 1) \
+  X(uint8_t, vcfLinear, 0, 1, 0, 1) \
+  X(uint8_t, vcaLinear, 0, 1, 0, 1) \
+  X(uint8_t, keyMode, 0, 2, 0, 1) \
+  X(uint8_t, modWheelDepth, 0, 10, 0, 1) \
+  X(uint8_t, pitchBendRange, 0, 12, 0, 1) \
+  X(int16_t, volume, 0, POT_MAX, 0, 1) \
+  X(uint8_t, clocksource, 0, 1, 0, 1) \
+  X(uint8_t, afterTouchDepth, 0, 10, 0, 1)
@@ -8,6 +8,8 @@
   RECALL
   Recall shows list of patches. Use encoder to move through list.
   Enter button on encoder chooses highlighted patch or press Recall again.
+  Save on the list searches the names: encoder and enter add characters as when naming, Back
+  removes one, Save again browses only the matching patches. Back from the list clears the search.
   Recall also recalls the current patch settings if the panel controls have been altered.
   Holding Recall for 1.5s will initialise the synth with all the current panel control settings - the synth sounds the same as the controls are set.
 
@@ -17,9 +19,6 @@
   Press Save again to save it. If you want to name/rename the patch, press the encoder enter button and use the encoder and enter button to choose an alphanumeric name.
   Holding Save for 1.5s will go into a patch deletion mode. Use encoder and enter button to choose and delete patch. Patch numbers will be changed on the SD card to be consecutive again.
 */
-//Agileware CircularBuffer available in libraries manager
-#include <CircularBuffer.hpp>
-
 #define TOTALCHARS 63
 
 const char CHARACTERS[TOTALCHARS] = {'a', 'b', 'c', 'd', 'e', 'f', 'g', 'h', 'i', 'j', 'k', 'l', 'm', 'n', 'o', 'p', 'q', 'r', 's', 't', 'u', 'v', 'w', 'x', 'y', 'z', 'A', 'B', 'C', 'D', 'E', 'F', 'G', 'H', 'I', 'J', 'K', 'L', 'M', 'N', 'O', 'P', 'Q', 'R', 'S', 'T', 'U', 'V', 'W', 'X', 'Y', 'Z', ' ', '1', '2', '3', '4', '5', '6', '7', '8', '9', '0'};
@@ -27,120 +26,367 @@ int charIndex = 0;
 char currentCharacter = 0;
 String renamedPatch = "";
 
-struct PatchNoAndName
+// Patch list
+//
+// Entries are 4 bytes, {patch number, offset of the name in the arena}, kept
+// sorted by number. Names are copied end to end into one arena, nothing is on
+// the heap. Browsing moves a cursor rather than rotating the list: first() is
+// the entry at the cursor, last() the one before it and [i] counts on from
+// first(), the same view the old CircularBuffer gave after rotating.
+//
+// RAM is fixed at build time, for PATCHES_LIMIT 999:
+//   entries  999 x 4                          3996 bytes
+//   arena    999 x (PATCH_NAME_MAX 16 + 1)   16983 bytes
+//   total                                    ~21KB, whatever is on the card
+// Longer names in old patch files are cut to PATCH_NAME_MAX for the list
+// only, the file keeps the full name. Removing an entry does not free its
+// name, the arena is reclaimed by clear() which every reload starts with.
+
+#define PATCH_NAME_MAX 16
+
+struct PatchEntry
 {
   int patchNo;
-  String patchName;
+  const char *patchName;
 };
 
-CircularBuffer<PatchNoAndName, PATCHES_LIMIT> patches;
-
-size_t readField(File *file, char *str, size_t size, const char *delim)
+class PatchIndex
 {
-  char ch;
-  size_t n = 0;
-  while ((n + 1) < size && file->read(&ch, 1) == 1)
+public:
+  void clear()
   {
-    // Delete CR.
-    if (ch == '\r')
-    {
-      continue;
-    }
-    str[n++] = ch;
-    if (strchr(delim, ch))
+    count = 0;
+    cursor = 0;
+    arenaUsed = 0;
+  }
+
+  int size() const
+  {
+    return count;
+  }
+
+  // Inserted in number order, the cursor stays on the same entry
+  bool push(int patchNo, const char *name)
+  {
+    if (count >= PATCHES_LIMIT || arenaUsed + PATCH_NAME_MAX + 1 > sizeof(arena)) return false;
+    uint16_t offset = arenaUsed;
+    size_t len = strnlen(name, PATCH_NAME_MAX);
+    memcpy(&arena[offset], name, len);
+    arena[offset + len] = 0;
+    arenaUsed += len + 1;
+
+    int pos = lowerBound(patchNo);
+    memmove(&entries[pos + 1], &entries[pos], (count - pos) * sizeof(Entry));
+    entries[pos] = {(uint16_t)patchNo, offset};
+    count++;
+    if (count > 1 && pos <= cursor) cursor++;  // Stays on the same entry, which moved up
+    return true;
+  }
+
+  PatchEntry operator[](int i) const
+  {
+    return at((cursor + i) % count);
+  }
+
+  PatchEntry first() const
+  {
+    return at(cursor);
+  }
+
+  PatchEntry last() const
+  {
+    return at(cursor == 0 ? count - 1 : cursor - 1);
+  }
+
+  // Entry pos in number order, ignoring the cursor
+  PatchEntry inOrder(int pos) const
+  {
+    return at(pos);
+  }
+
+  void next()
+  {
+    if (count) cursor = cursor + 1 == count ? 0 : cursor + 1;
+  }
+
+  void prev()
+  {
+    if (count) cursor = cursor == 0 ? count - 1 : cursor - 1;
+  }
+
+  // Sorted position of patchNo, -1 if it isn't on the card
+  int find(int patchNo) const
+  {
+    int pos = lowerBound(patchNo);
+    return pos < count && entries[pos].number == patchNo ? pos : -1;
+  }
+
+  // Moves the cursor to patchNo, false and left alone if there is none
+  bool seek(int patchNo)
+  {
+    int pos = find(patchNo);
+    if (pos < 0) return false;
+    cursor = pos;
+    return true;
+  }
+
+  void rewind()
+  {
+    cursor = 0;
+  }
+
+  // Drops first(), the next entry becomes first()
+  void removeFirst()
+  {
+    if (!count) return;
+    memmove(&entries[cursor], &entries[cursor + 1], (count - cursor - 1) * sizeof(Entry));
+    count--;
+    if (cursor == count) cursor = 0;
+  }
+
+private:
+  struct Entry
+  {
+    uint16_t number;
+    uint16_t nameOffset;
+  };
+
+  Entry entries[PATCHES_LIMIT];
+  char arena[PATCHES_LIMIT * (PATCH_NAME_MAX + 1)];
+  uint16_t arenaUsed = 0;
+  int count = 0;
+  int cursor = 0;
+
+  PatchEntry at(int pos) const
+  {
+    return {entries[pos].number, &arena[entries[pos].nameOffset]};
+  }
+
+  int lowerBound(int patchNo) const
+  {
+    int lo = 0, hi = count;
+    while (lo < hi)
     {
-      break;
+      int mid = (lo + hi) / 2;
+      if (entries[mid].number < patchNo) lo = mid + 1;
+      else hi = mid;
     }
+    return lo;
   }
-  str[n] = '\0';
-  return n;
+};
+
+static_assert(PATCHES_LIMIT * (PATCH_NAME_MAX + 1) <= 65535, "Name offsets are 16 bit");
+
+PatchIndex patches;
+
+// Patch search
+//
+// nameOrder holds the list positions sorted by name, case folded, and is
+// rebuilt whenever the list is reloaded. A search is then a binary search
+// for the names starting with the query, in name order, followed by one pass
+// for the names containing it further in, in number order. A full card is
+// well under a millisecond, so it reruns on every character.
+//
+// The matches are kept as patch numbers. While a search is active the RECALL
+// page browses only those, moving the list cursor onto each so recalling
+// works as it does unfiltered.
+
+uint16_t nameOrder[PATCHES_LIMIT];
+uint16_t nameOrderCount = 0;
+uint16_t searchMatches[PATCHES_LIMIT];
+uint16_t searchCount = 0;
+uint16_t searchCursor = 0;
+char searchQuery[PATCH_NAME_MAX + 1] = "";
+uint8_t searchLength = 0;
+boolean searchActive = false;
+uint32_t searchMicros = 0;  // Last search
+
+int compareNames(const void *a, const void *b)
+{
+  return strcasecmp(patches.inOrder(*(const uint16_t *)a).patchName, patches.inOrder(*(const uint16_t *)b).patchName);
 }
 
-int recallPatchData(File &patchFile, String data[])
+void buildNameIndex()
 {
-  size_t n;      // Length of returned field with delimiter.
-  char str[20];  // Must hold longest field with delimiter and zero byte.
-  int i = 0;
+  nameOrderCount = patches.size();
+  for (uint16_t i = 0; i < nameOrderCount; i++) nameOrder[i] = i;
+  qsort(nameOrder, nameOrderCount, sizeof(nameOrder[0]), compareNames);
+  searchActive = false;
+}
 
-  while (patchFile.available() && i < NO_OF_PARAMS)
+// Case folded, query anywhere in name
+bool nameContains(const char *name, const char *query, uint8_t length)
+{
+  for (; *name; name++)
   {
-    n = readField(&patchFile, str, sizeof(str), ",\n");
+    if (strncasecmp(name, query, length) == 0) return true;
+  }
+  return false;
+}
 
-    if (n == 0) break;  // error or EOF
+void runSearch()
+{
+  uint32_t start = micros();
+  searchCount = 0;
+  searchCursor = 0;
+  if (nameOrderCount != patches.size()) buildNameIndex();
 
-    if (str[n - 1] == ',' || str[n - 1] == '\n') {
-      str[n - 1] = 0;   // strip delimiter
-    } else {
-      Serial.print(patchFile.available() ? F("error: ") : F("eof:   "));
+  // Names starting with the query are one run of nameOrder
+  int lo = 0, hi = nameOrderCount;
+  while (lo < hi)
+  {
+    int mid = (lo + hi) / 2;
+    if (strncasecmp(patches.inOrder(nameOrder[mid]).patchName, searchQuery, searchLength) < 0) lo = mid + 1;
+    else hi = mid;
+  }
+  for (int i = lo; i < nameOrderCount; i++)
+  {
+    PatchEntry entry = patches.inOrder(nameOrder[i]);
+    if (strncasecmp(entry.patchName, searchQuery, searchLength) != 0) break;
+    searchMatches[searchCount++] = entry.patchNo;
+  }
+
+  // Then the rest containing it
+  for (int i = 0; i < nameOrderCount; i++)
+  {
+    PatchEntry entry = patches.inOrder(i);
+    if (entry.patchName[0] && nameContains(entry.patchName + 1, searchQuery, searchLength) &&
+        strncasecmp(entry.patchName, searchQuery, searchLength) != 0)
+    {
+      searchMatches[searchCount++] = entry.patchNo;
     }
+  }
+  searchActive = searchLength > 0;
+  if (searchActive && searchCount) patches.seek(searchMatches[0]);
+  searchMicros = micros() - start;  // On the Diagnostics settings page
+}
 
-    data[i++] = String(str);
-  }
-
-  return i; // <-- number of fields read
-}
-
-// void recallPatchData(File patchFile, String data[])
-// {
-//   //Read patch data from file and set current patch parameters
-//   size_t n;     // Length of returned field with delimiter.
-//   char str[20]; // Must hold longest field with delimiter and zero byte.
-//   int i = 0;
-//   while (patchFile.available() && i < NO_OF_PARAMS)
-//   {
-//     n = readField(&patchFile, str, sizeof(str), ",\n");
-//     // done if Error or at EOF.
-//     if (n == 0)
-//       break;
-//     // Print the type of delimiter.
-//     if (str[n - 1] == ',' || str[n - 1] == '\n')
-//     {
-//       // Remove the delimiter.
-//       str[n - 1] = 0;
-//     }
-//     else
-//     {
-//       // At eof, too long, or read error.  Too long is error.
-//       Serial.print(patchFile.available() ? F("error: ") : F("eof:   "));
-//     }
-//     // Print the field.
-//     //    Serial.print(i);
-//     //    Serial.print(" - ");
-//     //    Serial.println(str);
-//     data[i++] = String(str);
-//   }
-// }
-
-int compare(const void *a, const void *b) {
-  return ((PatchNoAndName*)a)->patchNo - ((PatchNoAndName*)b)->patchNo;
-}
-
-void sortPatches()
-{
-  int arraySize = patches.size();
-  //Sort patches buffer to be consecutive ascending patchNo order
-  struct PatchNoAndName arrayToSort[arraySize];
-
-  for (int i = 0; i < arraySize; ++i)
-  {
-    arrayToSort[i] = patches[i];
-  }
-  qsort(arrayToSort, arraySize, sizeof(PatchNoAndName), compare);
-  patches.clear();
+void searchAddChar(char c)
+{
+  if (searchLength >= PATCH_NAME_MAX) return;
+  searchQuery[searchLength++] = c;
+  searchQuery[searchLength] = 0;
+  runSearch();
+}
+
+// False once the query is empty
+bool searchDeleteChar()
+{
+  if (searchLength == 0) return false;
+  searchQuery[--searchLength] = 0;
+  runSearch();
+  return searchLength > 0;
+}
+
+void searchEnd()
+{
+  searchActive = false;
+  searchLength = 0;
+  searchQuery[0] = 0;
+  searchCount = 0;
+}
 
-  for (int i = 0; i < arraySize; ++i)
+// Moves over the matches only
+void searchStep(bool forward)
+{
+  if (!searchCount) return;
+  if (forward) searchCursor = searchCursor + 1 == searchCount ? 0 : searchCursor + 1;
+  else searchCursor = searchCursor == 0 ? searchCount - 1 : searchCursor - 1;
+  patches.seek(searchMatches[searchCursor]);
+}
+
+// Match i on from the cursor, wrapping
+int searchMatch(int i)
+{
+  return searchMatches[(searchCursor + i + searchCount) % searchCount];
+}
+
+// Every schema field in file order. A field missing from the end of an
+// older file takes its default, anything out of range is clamped.
+// Follows the name, files from before the version field are version 1
+int readPatchVersion(PatchReader &reader)
+{
+  if (reader.peek() != 'v') return 1;
+  reader.fieldChar();
+  return reader.readInt();
+}
+
+void readPatchFields(PatchReader &reader, PatchState &state)
+{
+  int fileVersion = readPatchVersion(reader);
+#define PATCH_READ(type, name, lo, hi, def, since) \
+  state.name = (since) <= fileVersion && reader.more() ? (type)constrain(reader.readInt(), (lo), (hi)) : (type)(def);
+  PATCH_FIELDS(PATCH_READ)
+#undef PATCH_READ
+  state.version = PATCH_STATE_VERSION;
+}
+
+void writePatchFields(String &data, const PatchState &state)
+{
+  data += ",v";
+  data += String(PATCH_STATE_VERSION);
+#define PATCH_WRITE(type, name, lo, hi, def, since) \
+  data += ','; \
+  data += String((int)state.name);
+  PATCH_FIELDS(PATCH_WRITE)
+#undef PATCH_WRITE
+}
+
+//Only the name is needed for the patch list, the rest of the file is left unread
+void recallPatchName(File &patchFile, char *name, size_t size)
+{
+  PatchReader reader(patchFile);
+  reader.readText(name, size);
+}
+
+// Patch banks
+//
+// Bank 0 is the card root, where every patch lived before banks. Banks 1 to
+// PATCH_BANKS are the directories /BANK01 ... /BANK16, made the first time
+// they are selected, each numbering its patches from 1. A NAME file in the
+// directory, one line, names the bank.
+//
+// Only the selected bank is in the patch list. It is indexed when the bank
+// is selected, so RAM and boot time stay the same however many banks the
+// card holds.
+#define PATCH_BANKS 16
+#define BANK_NAME_FILE "NAME"  // Not a number, so never taken for a patch
+
+uint8_t patchBank = 0;
+
+String bankDir(uint8_t bank)
+{
+  if (bank == 0) return String("/");
+  return String(bank < 10 ? "/BANK0" : "/BANK") + String(bank);
+}
+
+String patchPath(int patchNo)
+{
+  if (patchBank == 0) return String(patchNo);
+  return bankDir(patchBank) + "/" + String(patchNo);
+}
+
+void bankName(uint8_t bank, char *name, size_t size)
+{
+  File file = SD.open((bankDir(bank) + "/" + BANK_NAME_FILE).c_str());
+  if (file)
+  {
+    PatchReader reader(file);
+    reader.readText(name, size);
+    file.close();
+  }
+  else
   {
-    patches.push(arrayToSort[i]);
+    snprintf(name, size, bank == 0 ? "Root" : "Bank %d", bank);
   }
 }
 
 void loadPatches()
 {
-  File file = SD.open("/");
+  File file = SD.open(bankDir(patchBank).c_str());
   patches.clear();
   while (true)
   {
-    String data[NO_OF_PARAMS]; //Array of data read in
     File patchFile = file.openNextFile();
     if (!patchFile)
     {
@@ -150,27 +396,64 @@ void loadPatches()
     {
       Serial.println("Ignoring Dir");
     }
-    else
+    else if (atoi(patchFile.name()) > 0)
     {
-      recallPatchData(patchFile, data);
-      patches.push(PatchNoAndName{atoi(patchFile.name()), data[0]});
-      Serial.println(String(patchFile.name()) + ":" + data[0]);
+      char name[32];
+      recallPatchName(patchFile, name, sizeof(name));
+      patches.push(atoi(patchFile.name()), name);
+      Serial.println(String(patchFile.name()) + ":" + name);
     }
     patchFile.close();
   }
-  sortPatches();
+  buildNameIndex();
+}
+
+//Boot time version of loadPatches(), one file per call from loop() so
+//playing doesn't wait for the whole card to be read
+File patchIndexDir;
+boolean patchIndexReady = false;
+
+void startPatchIndex()
+{
+  patches.clear();
+  if (patchIndexDir) patchIndexDir.close();
+  patchIndexDir = SD.open(bankDir(patchBank).c_str());
+  patchIndexReady = false;
+}
+
+//Returns true once every file has been indexed
+boolean patchIndexStep()
+{
+  if (patchIndexReady) return true;
+  File patchFile = patchIndexDir.openNextFile();
+  if (!patchFile)
+  {
+    patchIndexDir.close();
+    patchIndexReady = true;
+    buildNameIndex();
+    return true;
+  }
+  if (!patchFile.isDirectory() && atoi(patchFile.name()) > 0)
+  {
+    char name[32];
+    recallPatchName(patchFile, name, sizeof(name));
+    patches.push(atoi(patchFile.name()), name);
+  }
+  patchFile.close();
+  return false;
 }
 
-void savePatch(const char *patchNo, String patchData)
+void savePatch(int patchNo, String patchData)
 {
   // Serial.print("savePatch Patch No:");
   //  Serial.println(patchNo);
+  String path = patchPath(patchNo);
   //Overwrite existing patch by deleting
-  if (SD.exists(patchNo))
+  if (SD.exists(path.c_str()))
   {
-    SD.remove(patchNo);
+    SD.remove(path.c_str());
   }
-  File patchFile = SD.open(patchNo, FILE_WRITE);
+  File patchFile = SD.open(path.c_str(), FILE_WRITE);
   if (patchFile)
   {
     //    Serial.print("Writing Patch No:");
@@ -186,42 +469,42 @@ void savePatch(const char *patchNo, String patchData)
   }
 }
 
-void savePatch(const char *patchNo, String patchData[])
+void deletePatch(int patchNo)
 {
-  String dataString = patchData[0];
-  for (int i = 1; i < NO_OF_PARAMS; i++)
-  {
-    dataString = dataString + "," + patchData[i];
-  }
-  savePatch(patchNo, dataString);
+  String path = patchPath(patchNo);
+  if (SD.exists(path.c_str())) SD.remove(path.c_str());
 }
 
-void deletePatch(const char *patchNo)
+//Files are copied a block at a time, the contents don't need parsing
+void copyPatchFile(int from, int to)
 {
-  if (SD.exists(patchNo)) SD.remove(patchNo);
+  File src = SD.open(patchPath(from).c_str());
+  if (!src) return;
+  String path = patchPath(to);
+  if (SD.exists(path.c_str())) SD.remove(path.c_str());
+  File dst = SD.open(path.c_str(), FILE_WRITE);
+  if (dst)
+  {
+    uint8_t block[PATCH_READ_BLOCK];
+    int n;
+    while ((n = src.read(block, sizeof(block))) > 0) dst.write(block, n);
+    dst.close();
+  }
+  src.close();
 }
 
 void renumberPatchesOnSD() {
   for (int i = 0; i < patches.size(); i++)
   {
-    String data[NO_OF_PARAMS]; //Array of data read in
-    File file = SD.open(String(patches[i].patchNo).c_str());
-    if (file) {
-      recallPatchData(file, data);
-      file.close();
-      savePatch(String(i + 1).c_str(), data);
-    }
+    if (patches[i].patchNo != i + 1) copyPatchFile(patches[i].patchNo, i + 1);
   }
-  deletePatch(String(patches.size() + 1).c_str()); //Delete final patch which is duplicate of penultimate patch
+  deletePatch(patches.size() + 1); //Delete final patch which is duplicate of penultimate patch
 }
 
 void setPatchesOrdering(int no) {
-  if (patches.size() < 2)return;
-  while (patches.first().patchNo != no) {
-    patches.push(patches.shift());
-  }
+  patches.seek(no);
 }
 
 void resetPatchesOrdering() {
-  setPatchesOrdering(1);
+  patches.rewind();
 }
@@ -0,0 +1,103 @@
+// Patch file reader
+//
+// Patch files are one CSV line. The file is read a 512 byte block at a time
+// and fields are parsed straight out of the block: numbers into the int
+// they set, text into the caller's buffer, compact sequences into the step
+// array. Nothing is copied into an intermediate field list.
+//
+// A field past the end of the file comes back as 0 / empty, as the older
+// String array gave; readPatchFields() uses the file's version to give
+// fields it doesn't have their defaults. Fields longer than the caller's
+// buffer are cut, not split into two.
+//
+// Only File::read() is used, so tools/patchreader_test.cpp builds this on a
+// PC to fuzz and time it.
+
+#define PATCH_READ_BLOCK 512
+#define PATCH_INT_MAX 99999999  // Longer numbers stop here rather than overflow
+
+class PatchReader
+{
+public:
+  PatchReader(File &file) : file(file) {}
+
+  // True while there is another field to read
+  bool more()
+  {
+    return peek() >= 0;
+  }
+
+  // Next character of the current field, -1 at its end. The delimiter is
+  // consumed so the next call starts the following field.
+  int fieldChar()
+  {
+    while (true)
+    {
+      int c = peek();
+      if (c < 0) return -1;
+      pos++;
+      if (c == '\r') continue;
+      if (c == ',' || c == '\n') return -1;
+      return c;
+    }
+  }
+
+  // Leading sign and digits, anything after them (a decimal part from a
+  // float field) is skipped, the same as toInt()
+  int readInt()
+  {
+    if (!more()) return 0;
+    int c = fieldChar();
+    bool negative = c == '-';
+    if (c == '-' || c == '+') c = fieldChar();
+    int value = 0;
+    while (c >= '0' && c <= '9')
+    {
+      if (value < PATCH_INT_MAX / 10) value = value * 10 + (c - '0');
+      else value = PATCH_INT_MAX;
+      c = fieldChar();
+    }
+    if (c >= 0) skipField();
+    return negative ? -value : value;
+  }
+
+  size_t readText(char *text, size_t size)
+  {
+    size_t n = 0;
+    if (more())
+    {
+      int c;
+      while ((c = fieldChar()) >= 0)
+      {
+        if (n + 1 < size) text[n++] = c;
+      }
+    }
+    text[n] = 0;
+    return n;
+  }
+
+  void skipField()
+  {
+    while (fieldChar() >= 0)
+    {
+    }
+  }
+
+  int peek()
+  {
+    if (pos == len)
+    {
+      int n = file.read(block, sizeof(block));
+      if (n <= 0) return -1;
+      len = n;
+      pos = 0;
+    }
+    return block[pos];
+  }
+
+private:
+  File &file;
+  uint8_t block[PATCH_READ_BLOCK];
+  uint16_t pos = 0;
+  uint16_t len = 0;
+};
@@ -261,8 +261,63 @@ void renderPatchNamingPage()
   tft.println(newPatchName);
 }
 
+void renderSearchPage()
+{
+  tft.fillScreen(ST7735_BLACK);
+  tft.setFont(&FreeSans12pt7b);
+  tft.setTextColor(ST7735_YELLOW);
+  tft.setTextSize(1);
+  tft.setCursor(0, 53);
+  tft.println("Find Patch");
+  tft.drawFastHLine(10, 62, tft.width() - 20, ST7735_RED);
+  tft.setTextColor(ST7735_WHITE);
+  tft.setCursor(5, 90);
+  tft.print(searchQuery);
+  tft.println(currentCharacter);
+  tft.setFont(&FreeSans9pt7b);
+  tft.setTextColor(ST7735_YELLOW);
+  tft.setCursor(5, 118);
+  tft.print(searchCount);
+  tft.println(searchCount == 1 ? " match" : " matches");
+}
+
+//While searching only the matches are listed, the query and position above
+void renderFilteredRecallPage()
+{
+  tft.fillScreen(ST7735_BLACK);
+  tft.setFont(&FreeSans9pt7b);
+  tft.setCursor(0, 18);
+  tft.setTextColor(ST7735_YELLOW);
+  tft.print(searchQuery);
+  tft.setCursor(110, 18);
+  tft.print(searchCursor + 1);
+  tft.print("/");
+  tft.println(searchCount);
+
+  for (int row = -1; row <= 1; row++)
+  {
+    if (searchCount < 2 && row != 0) continue;
+    if (searchCount == 2 && row == 1) continue;
+    int pos = patches.find(searchMatch(row));
+    if (pos < 0) continue;
+    int y = 72 + row * 26;
+    if (row == 0) tft.fillRect(0, 56, tft.width(), 23, 0xA000);
+    tft.setCursor(0, y);
+    tft.setTextColor(ST7735_YELLOW);
+    tft.println(patches.inOrder(pos).patchNo);
+    tft.setCursor(35, y);
+    tft.setTextColor(ST7735_WHITE);
+    tft.println(patches.inOrder(pos).patchName);
+  }
+}
+
 void renderRecallPage()
 {
+  if (searchActive)
+  {
+    renderFilteredRecallPage();
+    return;
+  }
   tft.fillScreen(ST7735_BLACK);
   tft.setFont(&FreeSans9pt7b);
   tft.setCursor(0, 45);
@@ -385,6 +440,9 @@ void displayThread()
       case PATCHNAMING:
         renderPatchNamingPage();
         break;
+      case SEARCH:
+        renderSearchPage();
+        break;
       case PATCH:
         renderCurrentPatchPage();
         break;
@@ -400,6 +458,7 @@ void displayThread()
         break;
     }
     tft.updateScreen();
+    if (displayFrameDelay) threads.delay(displayFrameDelay); //Slowed by the loop budget when loop() is overrunning
   }
 }
 
@@ -0,0 +1,111 @@
+// Sequence library
+//
+// Recorded sequences are kept once in SEQLIB_FILE and a patch stores
+// SEQ_LIBRARY_TAG and the library id in place of the sequence itself.
+// Saving a sequence that is already in the library, found by its FNV-1a
+// hash and then compared byte for byte, reuses its id, so patches sharing
+// a sequence share one copy. Empty sequences stay in the patch, they are
+// only three characters.
+//
+// The file is the arena: records of uint16 length, little endian, then the
+// compact encoding (see seqEncode()), an id being the record's position. It
+// is read into RAM in one go at boot and only ever appended to, the record
+// first so a patch never names an id the card doesn't have. A short last
+// record from a power cut is ignored. Once the arena is full new sequences
+// go back to being stored in the patch, as do all of them without an SD card.
+//
+// RAM, fixed at build time:
+//   arena    SEQLIB_ARENA                  16384 bytes
+//   entries  SEQLIB_MAX x 8                 4096 bytes
+
+#define SEQLIB_FILE "/SEQLIB/SEQS.BIN"  // In a directory so the patch list skips it
+#define SEQLIB_ARENA 16384
+#define SEQLIB_MAX 512
+constexpr char SEQ_LIBRARY_TAG = 'L';
+
+// Defined in Source.ino
+size_t seqEncode(const StepSeq &s, uint8_t *out);
+bool seqDecode(StepSeq &s, const uint8_t *in, size_t len);
+
+struct SeqLibEntry {
+  uint32_t hash;
+  uint16_t offset;  // Of the bytes, after the length
+  uint16_t length;
+};
+
+uint8_t seqLibArena[SEQLIB_ARENA];
+SeqLibEntry seqLibEntries[SEQLIB_MAX];
+uint16_t seqLibCount = 0;
+uint16_t seqLibUsed = 0;
+boolean seqLibReady = false;
+
+uint32_t seqLibHash(const uint8_t *bytes, size_t length) {
+  uint32_t hash = 2166136261u;
+  for (size_t i = 0; i < length; i++) hash = (hash ^ bytes[i]) * 16777619u;
+  return hash;
+}
+
+// Indexes the records in the arena from seqLibUsed on
+void seqLibIndex(uint16_t end) {
+  while (seqLibCount < SEQLIB_MAX && seqLibUsed + 2 <= end) {
+    uint16_t length = seqLibArena[seqLibUsed] | seqLibArena[seqLibUsed + 1] << 8;
+    if (length == 0 || seqLibUsed + 2 + length > end) break;
+    uint16_t offset = seqLibUsed + 2;
+    seqLibEntries[seqLibCount++] = { seqLibHash(&seqLibArena[offset], length), offset, length };
+    seqLibUsed = offset + length;
+  }
+}
+
+void seqLibLoad() {
+  seqLibCount = 0;
+  seqLibUsed = 0;
+  SD.mkdir("/SEQLIB");
+  File file = SD.open(SEQLIB_FILE);
+  if (file) {
+    int n = file.read(seqLibArena, sizeof(seqLibArena));
+    file.close();
+    if (n > 0) seqLibIndex(n);
+  }
+  seqLibReady = true;
+  Serial.println("Sequence library " + String(seqLibCount) + " sequences, " + String(seqLibUsed) + " bytes");
+}
+
+int seqLibFind(const uint8_t *bytes, size_t length) {
+  uint32_t hash = seqLibHash(bytes, length);
+  for (uint16_t i = 0; i < seqLibCount; i++) {
+    const SeqLibEntry &e = seqLibEntries[i];
+    if (e.hash == hash && e.length == length && memcmp(&seqLibArena[e.offset], bytes, length) == 0) return i;
+  }
+  return -1;
+}
+
+// Id of the sequence, added if it is new, -1 if it has to stay in the patch
+int seqLibStore(const StepSeq &s) {
+  if (!seqLibReady || s.length == 0) return -1;
+  uint8_t bytes[SEQ_ENCODED_MAX + 2];
+  size_t length = seqEncode(s, &bytes[2]);
+  int id = seqLibFind(&bytes[2], length);
+  if (id >= 0) return id;
+  if (seqLibCount >= SEQLIB_MAX || seqLibUsed + 2 + length > SEQLIB_ARENA) return -1;
+
+  bytes[0] = length & 0xFF;
+  bytes[1] = length >> 8;
+  File file = SD.open(SEQLIB_FILE, FILE_WRITE);
+  if (!file) return -1;
+  // A record cut short earlier is overwritten, not left in front of this one
+  file.seek(seqLibUsed);
+  size_t written = file.write(bytes, length + 2);
+  file.close();
+  if (written != length + 2) return -1;
+
+  memcpy(&seqLibArena[seqLibUsed], bytes, length + 2);
+  seqLibIndex(seqLibUsed + length + 2);
+  return seqLibCount - 1;
+}
+
+// Unknown ids, from a card that has lost its library, give an empty sequence
+bool seqLibGet(int id, StepSeq &s) {
+  if (id < 0 || id >= seqLibCount) return false;
+  const SeqLibEntry &e = seqLibEntries[id];
+  return seqDecode(s, &seqLibArena[e.offset], e.length);
+}
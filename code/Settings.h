@@ -6,6 +6,14 @@ void settingsPitchBend(int index, const char *value);
 void settingsModWheelDepth(int index, const char *value);
 void settingsKeyMode(int index, const char *value);
 void settingsClockSource(int index, const char *value);
+void settingsSeqClock(int index, const char *value);
+void settingsClockDiv(int index, const char *value);
+void settingsBrowseDelay(int index, const char *value);
+void settingsPatchSync(int index, const char *value);
+void settingsMorphTime(int index, const char *value);
+void settingsPatchBank(int index, const char *value);
+void settingsMidiLearn(int index, const char *value);
+void settingsHiResPairs(int index, const char *value);
 
 int currentIndexMIDICh();
 int currentIndexEncoderDir();
@@ -13,6 +21,20 @@ int currentIndexPitchBend();
 int currentIndexModWheelDepth();
 int currentIndexKeyMode();
 int currentIndexClockSource();
+int currentIndexSeqClock();
+int currentIndexClockDiv();
+int currentIndexBrowseDelay();
+int currentIndexPatchSync();
+int currentIndexMorphTime();
+int currentIndexPatchBank();
+int currentIndexMidiLearn();
+int currentIndexHiResPairs();
+
+void seqClockSourceChanged();  // Source.ino
+void selectBank(uint8_t bank, int patch);  // Source.ino
+void midiLearnMode(int index);  // MidiLearn.h
+extern boolean ccLearnMode;
+void hiResSetup(boolean pairs);  // MidiHiRes.h
 
 
 void settingsMIDICh(int index, const char *value) {
@@ -73,6 +95,50 @@ void settingsClockSource(int index, const char *value) {
   storeClockSource(clocksource);
 }
 
+void settingsSeqClock(int index, const char *value) {
+  if (strcmp(value, "Internal") == 0) seqClockSource = SEQ_CLOCK_INTERNAL;
+  if (strcmp(value, "External") == 0) seqClockSource = SEQ_CLOCK_EXTERNAL;
+  storeSeqClock(seqClockSource);
+  seqClockSourceChanged();
+}
+
+void settingsClockDiv(int index, const char *value) {
+  setClockDivIndex(index);
+  storeClockDiv(clockDivIndex);
+}
+
+const unsigned int BROWSE_DELAYS[] = { 150, 300, 500, 1000 };
+
+void settingsBrowseDelay(int index, const char *value) {
+  index = constrain(index, 0, 3);
+  browseDelay = BROWSE_DELAYS[index];
+  storeBrowseDelay(index);
+}
+
+void settingsPatchSync(int index, const char *value) {
+  if (strcmp(value, "Immediate") == 0) patchSyncGate = false;
+  if (strcmp(value, "Note Off") == 0) patchSyncGate = true;
+  storePatchSync(patchSyncGate ? 1 : 0);
+}
+
+void settingsMorphTime(int index, const char *value) {
+  morphTimeIndex = constrain(index, 0, MORPH_MANUAL);
+  storeMorphTime(morphTimeIndex);
+}
+
+void settingsPatchBank(int index, const char *value) {
+  selectBank(index, 1);
+}
+
+void settingsMidiLearn(int index, const char *value) {
+  midiLearnMode(index);
+}
+
+void settingsHiResPairs(int index, const char *value) {
+  hiResSetup(index == 1);
+  storeHiResPairs(index);
+}
+
 int currentIndexMIDICh() {
   return getMIDIChannel();
 }
@@ -105,6 +171,62 @@ int currentIndexClockSource() {
   return getClockSource();
 }
 
+int currentIndexSeqClock() {
+  return getSeqClock();
+}
+
+int currentIndexClockDiv() {
+  return getClockDiv();
+}
+
+int currentIndexBrowseDelay() {
+  return getBrowseDelay();
+}
+
+int currentIndexPatchSync() {
+  return getPatchSync();
+}
+
+int currentIndexMorphTime() {
+  return getMorphTime();
+}
+
+int currentIndexPatchBank() {
+  return patchBank;
+}
+
+int currentIndexMidiLearn() {
+  return ccLearnMode ? 1 : 0;
+}
+
+int currentIndexHiResPairs() {
+  return getHiResPairs();
+}
+
+// One pair of settings per mod matrix slot
+template<uint8_t slot>
+void settingsModSource(int index, const char *value) {
+  modEditRoute(slot, index, -1);
+}
+
+template<uint8_t slot>
+void settingsModDest(int index, const char *value) {
+  modEditRoute(slot, -1, index);
+}
+
+template<uint8_t slot>
+int currentIndexModSource() {
+  return modRoutes[slot].source;
+}
+
+template<uint8_t slot>
+int currentIndexModDest() {
+  return modRoutes[slot].dest;
+}
+
+#define MOD_SOURCE_VALUES { "None", "LFO 3", "LFO 4", "Loop Env", "S&H", "\0" }
+#define MOD_DEST_VALUES { "None", "Cutoff", "OSC1 PW", "OSC2 PW", "OSC1 Level", "OSC2 Level", "Volume", "\0" }
+
 // add settings to the circular buffer
 void setUpSettings() {
   settings::append(settings::SettingsOption{ "MIDI In Ch.", { "All", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15", "16", "\0" }, settingsMIDICh, currentIndexMIDICh });
@@ -114,4 +236,21 @@ void setUpSettings() {
   settings::append(settings::SettingsOption{ "MW Depth", { "Off", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "\0" }, settingsModWheelDepth, currentIndexModWheelDepth });
   settings::append(settings::SettingsOption{ "AT Depth", { "Off", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "\0" }, settingsAfterTouchDepth, currentIndexAfterTouchDepth });
   settings::append(settings::SettingsOption{ "LFO Clock", {"External", "MIDI", "\0"}, settingsClockSource, currentIndexClockSource });
+  settings::append(settings::SettingsOption{ "Seq Clock", {"Internal", "External", "\0"}, settingsSeqClock, currentIndexSeqClock });
+  settings::append(settings::SettingsOption{ "Clock Div", {"1/4", "1/3", "1/2", "1", "x2", "x3", "x4", "\0"}, settingsClockDiv, currentIndexClockDiv });
+  settings::append(settings::SettingsOption{ "Browse Delay", {"150ms", "300ms", "500ms", "1s", "\0"}, settingsBrowseDelay, currentIndexBrowseDelay });
+  settings::append(settings::SettingsOption{ "Patch Change", {"Immediate", "Note Off", "\0"}, settingsPatchSync, currentIndexPatchSync });
+  settings::append(settings::SettingsOption{ "Morph Time", {"0.5s", "1s", "2s", "5s", "10s", "Mod Wheel", "\0"}, settingsMorphTime, currentIndexMorphTime });
+  settings::append(settings::SettingsOption{ "Patch Bank", {"Root", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15", "16", "\0"}, settingsPatchBank, currentIndexPatchBank });
+  settings::append(settings::SettingsOption{ "MIDI Learn", {"Off", "On", "Clear", "\0"}, settingsMidiLearn, currentIndexMidiLearn });
+  settings::append(settings::SettingsOption{ "14 bit CC", {"Off", "On", "\0"}, settingsHiResPairs, currentIndexHiResPairs });
+  settings::append(settings::SettingsOption{ "Mod 1 Src", MOD_SOURCE_VALUES, settingsModSource<0>, currentIndexModSource<0> });
+  settings::append(settings::SettingsOption{ "Mod 1 Dest", MOD_DEST_VALUES, settingsModDest<0>, currentIndexModDest<0> });
+  settings::append(settings::SettingsOption{ "Mod 2 Src", MOD_SOURCE_VALUES, settingsModSource<1>, currentIndexModSource<1> });
+  settings::append(settings::SettingsOption{ "Mod 2 Dest", MOD_DEST_VALUES, settingsModDest<1>, currentIndexModDest<1> });
+  settings::append(settings::SettingsOption{ "Mod 3 Src", MOD_SOURCE_VALUES, settingsModSource<2>, currentIndexModSource<2> });
+  settings::append(settings::SettingsOption{ "Mod 3 Dest", MOD_DEST_VALUES, settingsModDest<2>, currentIndexModDest<2> });
+  settings::append(settings::SettingsOption{ "Mod 4 Src", MOD_SOURCE_VALUES, settingsModSource<3>, currentIndexModSource<3> });
+  settings::append(settings::SettingsOption{ "Mod 4 Dest", MOD_DEST_VALUES, settingsModDest<3>, currentIndexModDest<3> });
+  settings::append(settings::SettingsOption{ "Diagnostics", {diagValues[0], diagValues[1], diagValues[2], diagValues[3], diagValues[4], diagValues[5], "\0"}, settingsDiagnostics, currentIndexDiagnostics });
 }
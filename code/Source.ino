@@ -12,7 +12,6 @@
   Optimize: "Fastest"
 
   Additional libraries:
-    Agileware CircularBuffer available in Arduino libraries manager
     Replacement files are in the Modified Libraries folder and need to be placed in the teensy Audio folder.
 */
 
@@ -24,11 +23,20 @@
 #include <USBHost_t36.h>
 #include "MidiCC.h"
 #include "Constants.h"
+#include "PatchFields.h"
 #include "Parameters.h"
+#include "PatchReader.h"
 #include "PatchMgr.h"
 #include "HWControls.h"
+#include "Trace.h"
 #include "EepromMgr.h"
+#include "ExtClock.h"
+#include "PanelSwitches.h"
+#include "Morph.h"
+#include "ModMatrix.h"
+#include "LoopBudget.h"
 #include "Settings.h"
+#include "SeqLibrary.h"
 #include <ShiftRegister74HC595.h>
 #include <RoxMux.h>
 
@@ -42,6 +50,7 @@
 #define DELETEMSG 7      //Delete patch message page
 #define SETTINGS 8       //Settings page
 #define SETTINGSVALUE 9  //Settings page
+#define SEARCH 10        //Patch name search page
 unsigned int state = PARAMETER;
 #include "ST7735Display.h"
 
@@ -50,6 +59,7 @@ unsigned int state = PARAMETER;
 //
 int DelayForSH3 = 10;
 int patchNo = 0;
+uint8_t midiBank = 0;  //From CCbankSelect, for the next program change
 unsigned long buttonDebounce = 0;
 boolean cardStatus = false;
 
@@ -64,6 +74,12 @@ MIDIDevice midi1(myusb);
 //MIDI 5 Pin DIN
 MIDI_CREATE_INSTANCE(HardwareSerial, Serial1, MIDI);  //RX - Pin 0
 
+#include "SysexDump.h"
+#include "Autosave.h"
+#include "MidiLearn.h"
+#include "MidiHiRes.h"
+#include "MidiOut.h"
+
 //
 // MIDI to CV conversion
 //
@@ -90,6 +106,7 @@ int8_t d2, i;
 // data, clk, latch
 //
 ShiftRegister74HC595<6> srpanel(6, 7, 9);
+#include "LedFrame.h"
 
 // pins for 74HC595
 #define BOARD_DATA 36   // pin 14 on 74HC595 (DATA)
@@ -99,53 +116,87 @@ ShiftRegister74HC595<6> srpanel(6, 7, 9);
 #define SWITCH_TOTAL 3
 Rox74HC595<SWITCH_TOTAL> boardswitch;
 
-// pins for 74HC165
-#define BTN_DEBOUNCE 50
+// pins for 74HC165, scanned in PanelSwitches.h
 #define PIN_DATA 35  // pin 9 on 74HC165 (DATA)
 #define PIN_LOAD 34  // pin 1 on 74HC165 (LOAD)
 #define PIN_CLK 33   // pin 2 on 74HC165 (CLK))
-#define MUX_TOTAL 6
-RoxOctoswitch<MUX_TOTAL, BTN_DEBOUNCE> mux;
 
 //
 // Start setup
 //
 
+// Boot trace, micros() at the end of each stage. Printed once the background
+// stages in loop() have finished too.
+#define BOOT_STAGES_MAX 10
+#define USB_HOST_START_MS 200  //Wait to turn on USB Host
+
+const char *bootStageNames[BOOT_STAGES_MAX];
+uint32_t bootStageMicros[BOOT_STAGES_MAX];
+uint8_t bootStageCount = 0;
+boolean bootReported = false;
+boolean usbHostStarted = false;
+boolean bootPatchLoaded = false;  //Also cleared by a bank change that didn't find its patch
+uint32_t bootMillis = 0;
+
+void bootStage(const char *name) {
+  if (bootStageCount >= BOOT_STAGES_MAX) return;
+  bootStageNames[bootStageCount] = name;
+  bootStageMicros[bootStageCount++] = micros();
+}
+
+void bootReport() {
+  bootReported = true;
+  Serial.println("Boot trace (us since reset, us in stage):");
+  uint32_t prev = bootStageMicros[0];
+  for (int i = 1; i < bootStageCount; i++) {
+    Serial.println("  " + String(bootStageNames[i]) + " " + String(bootStageMicros[i]) + " +" + String(bootStageMicros[i] - prev));
+    prev = bootStageMicros[i];
+  }
+}
+
+void startUsbHost() {
+  usbHostStarted = true;
+  myusb.begin();
+  Serial.println("USB HOST MIDI Class Compliant Listening");
+  bootStage("usb host");
+}
+
+void patchIndexDone() {
+  if (patches.size() == 0) {
+    //save an initialised patch to SD card
+    savePatch(1, INITPATCH);
+    loadPatches();
+  }
+  //The last patch may have gone since it was stored
+  if (!bootPatchLoaded) {
+    patchNo = patches.first().patchNo;
+    recallPatch(patchNo);
+    bootPatchLoaded = true;
+  }
+  setPatchesOrdering(patchNo);
+  bootStage("patch index");
+}
+
+//Playing comes first: MIDI, panel and the last patch are set up here, the
+//patch list, USB host and display finish from loop()
 void setup() {
+  bootStage("reset");
+  bootMillis = millis();
   SPI.begin();
-  setupDisplay();
   setUpSettings();
   setupHardware();
 
-  cardStatus = SD.begin(BUILTIN_SDCARD);
-  if (cardStatus) {
-    Serial.println("SD card is connected");
-    //Get patch numbers and names from SD card
-    loadPatches();
-    if (patches.size() == 0) {
-      //save an initialised patch to SD card
-      savePatch("1", INITPATCH);
-      loadPatches();
-    }
-  } else {
-    Serial.println("SD card is not connected or unusable");
-    reinitialiseToPanel();
-    showPatchPage("No SD", "conn'd / usable");
-  }
-
-  //Read MIDI Channel from EEPROM
+  loadSettingsJournal();
   midiChannel = getMIDIChannel();
   Serial.println("MIDI Ch:" + String(midiChannel) + " (0 is Omni On)");
+  bootStage("hardware");
 
-  //USB HOST MIDI Class Compliant
-  delay(200);  //Wait to turn on USB Host
-  myusb.begin();
+  //USB HOST MIDI Class Compliant, begins from loop()
   midi1.setHandleControlChange(myConvertControlChange);
   midi1.setHandlePitchChange(myPitchBend);
   midi1.setHandleProgramChange(myProgramChange);
   midi1.setHandleNoteOff(myNoteOff);
   midi1.setHandleNoteOn(myNoteOn);
-  Serial.println("USB HOST MIDI Class Compliant Listening");
 
   //USB Client MIDI
   usbMIDI.setHandleControlChange(myConvertControlChange);
@@ -174,6 +225,11 @@ void setup() {
 
   Serial.println("MIDI In DIN Listening");
 
+  //Patch dump and restore on all three ports
+  sysexSetup();
+  midiOutSetup();
+  bootStage("midi");
+
   //Read Key Tracking from EEPROM, this can be set individually by each patch.
   keyMode = getKeyMode();
 
@@ -188,14 +244,19 @@ void setup() {
 
   //Read Encoder Direction from EEPROM
   encCW = getEncoderDir();
+  browseDelay = BROWSE_DELAYS[getBrowseDelay()];
+  patchSyncGate = getPatchSync();
+  morphTimeIndex = getMorphTime();
+  patchBank = getPatchBank();
+  hiResSetup(getHiResPairs());
+  midiBank = patchBank;
   level1 = 1;
   level2 = 0;
 
-  // srpanel.set(OSC2_32_LED, HIGH);
-  // srpanel.set(OSC2_32_LED, LOW);
+  // ledSet(OSC2_32_LED, HIGH);
+  // ledSet(OSC2_32_LED, LOW);
 
-  mux.begin(PIN_DATA, PIN_LOAD, PIN_CLK);
-  mux.setCallback(onButtonPress);
+  switchScanBegin(PIN_DATA, PIN_LOAD, PIN_CLK);
 
   boardswitch.begin(BOARD_DATA, BOARD_LATCH, BOARD_CLK, BOARD_PWM);
 
@@ -211,34 +272,203 @@ void setup() {
       break;
   }
 
-  srpanel.set(LEVEL1_LED, HIGH);
-  patchNo = getLastPatch();
-  recallPatch(patchNo);  //Load first patch
+  modSetup();
+
+  seqClockSource = getSeqClock();
+  clockDivIndex = getClockDiv();
+  setupExtClock();
+
+  ledSet(LEVEL1_LED, HIGH);
+  bootStage("panel");
+
+  //Last patch straight from its file, the patch list is built afterwards
+  ccRemapReset();
+  cardStatus = SD.begin(BUILTIN_SDCARD);
+  if (cardStatus) {
+    Serial.println("SD card is connected");
+    seqLibLoad();
+    ccRemapLoad();
+    patchNo = getLastPatch();
+    int journalPatch = autosaveSetup();
+    if (journalPatch > 0) patchNo = journalPatch;
+    bootPatchLoaded = loadPatch(patchNo, LOAD_RECALL);
+    if (bootPatchLoaded && journalPatch > 0) autosaveRestore();
+    startPatchIndex();
+  } else {
+    Serial.println("SD card is not connected or unusable");
+    reinitialiseToPanel();
+    showPatchPage("No SD", "conn'd / usable");
+    patchIndexReady = true;
+  }
+  bootStage("first patch");
+
+  flushLeds();
+
+  setupDisplay();
+  bootStage("display");
+}
+
+// Compact sequence encoding
+//
+//   byte 0       length
+//   per step     note | rest << 7, velocity | ext << 7
+//   if ext       flags (SEQ_EXT_*), then [gate] [micro + 64] if flagged
+//
+// A step with the default gate and no timing offset costs two bytes and only
+// the recorded steps are written. In a patch file the bytes are base64 encoded
+// into a single field starting with SEQ_COMPACT_TAG, or kept once in the
+// sequence library and named by SEQ_LIBRARY_TAG and its id, see SeqLibrary.h.
+#define SEQ_EXT_TIE 0x01
+#define SEQ_EXT_SLIDE 0x02
+#define SEQ_EXT_ACCENT 0x04
+#define SEQ_EXT_GATE 0x08
+#define SEQ_EXT_MICRO 0x10
+
+const char BASE64_CHARS[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+SeqStep seqMakeStep(uint8_t note, uint8_t velocity, bool rest) {
+  SeqStep st = {};
+  st.note = note & 0x7F;
+  st.rest = rest;
+  st.velocity = velocity & 0x7F;
+  st.gate = SEQ_DEFAULT_GATE;
+  return st;
+}
+
+size_t seqEncode(const StepSeq &s, uint8_t *out) {
+  size_t n = 0;
+  out[n++] = s.length;
+  for (int i = 0; i < s.length; i++) {
+    const SeqStep &st = s.steps[i];
+    uint8_t ext = (st.tie ? SEQ_EXT_TIE : 0) | (st.slide ? SEQ_EXT_SLIDE : 0) | (st.accent ? SEQ_EXT_ACCENT : 0)
+                  | (st.gate != SEQ_DEFAULT_GATE ? SEQ_EXT_GATE : 0) | (st.micro != 0 ? SEQ_EXT_MICRO : 0);
+    out[n++] = st.note | (st.rest << 7);
+    out[n++] = st.velocity | (ext ? 0x80 : 0);
+    if (ext) {
+      out[n++] = ext;
+      if (ext & SEQ_EXT_GATE) out[n++] = st.gate;
+      if (ext & SEQ_EXT_MICRO) out[n++] = (uint8_t)(st.micro + 64);
+    }
+  }
+  return n;
+}
+
+// Truncated data keeps the steps decoded so far
+bool seqDecode(StepSeq &s, const uint8_t *in, size_t len) {
+  clearSeq(s);
+  if (len < 1) return false;
+  uint8_t length = min(in[0], SEQ_MAX_STEPS);
+  size_t n = 1;
+  for (int i = 0; i < length; i++) {
+    if (n + 2 > len) return false;
+    SeqStep st = seqMakeStep(in[n] & 0x7F, in[n + 1] & 0x7F, in[n] & 0x80);
+    bool ext = in[n + 1] & 0x80;
+    n += 2;
+    if (ext) {
+      if (n >= len) return false;
+      uint8_t flags = in[n++];
+      st.tie = (flags & SEQ_EXT_TIE) != 0;
+      st.slide = (flags & SEQ_EXT_SLIDE) != 0;
+      st.accent = (flags & SEQ_EXT_ACCENT) != 0;
+      if (flags & SEQ_EXT_GATE) {
+        if (n >= len) return false;
+        uint8_t gate = in[n++] & 0x7F;
+        st.gate = gate ? gate : 1;
+      }
+      if (flags & SEQ_EXT_MICRO) {
+        if (n >= len) return false;
+        st.micro = (int)(in[n++] & 0x7F) - 64;
+      }
+    }
+    s.steps[i] = st;
+    s.length = i + 1;
+  }
+  return true;
+}
+
+int base64Value(char c) {
+  if (c >= 'A' && c <= 'Z') return c - 'A';
+  if (c >= 'a' && c <= 'z') return c - 'a' + 26;
+  if (c >= '0' && c <= '9') return c - '0' + 52;
+  if (c == '+') return 62;
+  if (c == '/') return 63;
+  return -1;
+}
+
+// Library id if the library can take it, otherwise the sequence itself
+String seqField(const StepSeq &s) {
+  int id = seqLibStore(s);
+  if (id < 0) return seqToCsv(s);
+  return String(SEQ_LIBRARY_TAG) + String(id);
 }
 
 String seqToCsv(const StepSeq &s) {
+  uint8_t bin[SEQ_ENCODED_MAX];
+  size_t n = seqEncode(s, bin);
   String out;
-  out.reserve(4 + SEQ_MAX_STEPS * 4);
-  out += String(s.length);
-  for (int i = 0; i < SEQ_MAX_STEPS; i++) {
-    out += ",";
-    out += String((int)s.steps[i]);
+  out.reserve(SEQ_FIELD_MAX);
+  out += SEQ_COMPACT_TAG;
+  for (size_t i = 0; i < n; i += 3) {
+    uint32_t v = ((uint32_t)bin[i] << 16) | (i + 1 < n ? bin[i + 1] << 8 : 0) | (i + 2 < n ? bin[i + 2] : 0);
+    out += BASE64_CHARS[(v >> 18) & 63];
+    out += BASE64_CHARS[(v >> 12) & 63];
+    if (i + 1 < n) out += BASE64_CHARS[(v >> 6) & 63];
+    if (i + 2 < n) out += BASE64_CHARS[v & 63];
   }
   return out;
 }
 
-void csvToSeq(StepSeq &s, String data[], int &idx, int totalFields) {
+// Decodes the rest of the field after SEQ_COMPACT_TAG, stops at the first non base64 character
+void seqFromCompact(StepSeq &s, PatchReader &reader) {
+  uint8_t bin[SEQ_ENCODED_MAX];
+  size_t n = 0;
+  uint32_t acc = 0;
+  int bits = 0;
+  int c;
+  while ((c = reader.fieldChar()) >= 0) {
+    int v = base64Value(c);
+    if (v < 0 || n == sizeof(bin)) {
+      reader.skipField();
+      break;
+    }
+    acc = (acc << 6) | v;
+    bits += 6;
+    if (bits >= 8) {
+      bits -= 8;
+      bin[n++] = (acc >> bits) & 0xFF;
+    }
+  }
+  seqDecode(s, bin, n);
+}
+
+void readSeq(StepSeq &s, PatchReader &reader) {
   // If not enough fields, leave sequence empty (backward compatibility)
-  if (idx >= totalFields) {
-    s.length = 0;
+  if (!reader.more()) {
+    clearSeq(s);
+    return;
+  }
+
+  if (reader.peek() == SEQ_COMPACT_TAG) {
+    reader.fieldChar();
+    seqFromCompact(s, reader);
+    s.index = 0;
+    return;
+  }
+
+  if (reader.peek() == SEQ_LIBRARY_TAG) {
+    reader.fieldChar();
+    if (!seqLibGet(reader.readInt(), s)) clearSeq(s);
     s.index = 0;
     return;
   }
 
-  s.length = (uint8_t)constrain(data[idx++].toInt(), 0, SEQ_MAX_STEPS);
+  // Old format, length then all 64 note numbers
+  clearSeq(s);
+  s.length = (uint8_t)constrain(reader.readInt(), 0, SEQ_MAX_STEPS);
   for (int i = 0; i < SEQ_MAX_STEPS; i++) {
-    if (idx < totalFields) s.steps[i] = (uint8_t)data[idx++].toInt();
-    else s.steps[i] = SEQ_REST;  // default if truncated
+    if (!reader.more()) break;  // remaining steps stay as rests
+    int step = reader.readInt();
+    s.steps[i] = seqMakeStep(step, SEQ_DEFAULT_VELOCITY, step == SEQ_REST);
   }
   s.index = 0;
 }
@@ -246,7 +476,7 @@ void csvToSeq(StepSeq &s, String data[], int &idx, int totalFields) {
 void clearSeq(StepSeq &s) {
   s.length = 0;
   s.index = 0;
-  for (int i = 0; i < SEQ_MAX_STEPS; i++) s.steps[i] = SEQ_REST;
+  for (int i = 0; i < SEQ_MAX_STEPS; i++) s.steps[i] = seqMakeStep(0, SEQ_DEFAULT_VELOCITY, true);
 }
 
 inline StepSeq &currentRecSeq() {
@@ -256,63 +486,200 @@ inline StepSeq &currentPlaySeq() {
   return (playTarget == 2) ? seq2 : seq1;
 }
 
+// The sequencer step timer and the external clock interrupt play notes as
+// well. Loop code that plays notes or changes the sequencer / arp state
+// holds them off for its scope with a VoiceLock, a few microseconds. Locks
+// nest, the outermost turns interrupts back on.
+struct VoiceLock {
+  uint32_t primask;
+  VoiceLock() {
+    __asm__ volatile("mrs %0, primask" : "=r"(primask));
+    noInterrupts();
+  }
+  ~VoiceLock() {
+    if (!primask) interrupts();
+  }
+};
+
+void seqGateOff() {
+  seqGateTimer.end();
+  writeGate(LOW);
+  gatepulse = 0;
+  seqHeld = false;
+  seqSlideGlide = false;
+}
+
+void seqStopClock() {
+  seqStepTimer.end();
+  seqGateTimer.end();
+}
+
+void seqRecordLeds(uint8_t target) {
+  ledBlink(BUTTON1_LED, target == 1);
+  ledBlink(BUTTON2_LED, target == 2);
+}
+
 void seqResetRecord(uint8_t target) {
+  seqStopClock();
+  seqRecordLeds(target);
   recordTarget = target;
   seqState = SEQ_RECORDING;
   StepSeq &s = currentRecSeq();
   s.length = 0;
   s.index = 0;
-  digitalWrite(GATE_NOTE1, LOW);
-  gatepulse = 0;
+  seqGateOff();
 }
 
-void seqAppendStep(uint8_t value) {
+void seqAppendStep(const SeqStep &step) {
   if (seqState != SEQ_RECORDING || recordTarget == 0) return;
   StepSeq &s = currentRecSeq();
   if (s.length >= SEQ_MAX_STEPS) return;
-  s.steps[s.length++] = value;
+  s.steps[s.length++] = step;
+}
+
+void seqAppendNote(uint8_t note, uint8_t velocity) {
+  seqAppendStep(seqMakeStep(note, velocity, false));
+}
+
+// Playing legato while recording (new note before the last is released) slides
+// from the previous step
+void seqMarkSlide() {
+  if (seqState != SEQ_RECORDING || recordTarget == 0 || !gatepulse) return;
+  StepSeq &s = currentRecSeq();
+  if (s.length > 0) s.steps[s.length - 1].slide = 1;
+}
+
+// Tie and accent apply to the last recorded step
+bool seqToggleTie() {
+  StepSeq &s = currentRecSeq();
+  if (seqState != SEQ_RECORDING || s.length == 0) return false;
+  SeqStep &st = s.steps[s.length - 1];
+  st.tie = !st.tie;
+  return st.tie;
+}
+
+bool seqToggleAccent() {
+  StepSeq &s = currentRecSeq();
+  if (seqState != SEQ_RECORDING || s.length == 0) return false;
+  SeqStep &st = s.steps[s.length - 1];
+  st.accent = !st.accent;
+  return st.accent;
 }
 
 void seqInsertRest() {
-  seqAppendStep(SEQ_REST);
-  digitalWrite(GATE_NOTE1, LOW);
-  gatepulse = 0;
+  seqAppendStep(seqMakeStep(0, SEQ_DEFAULT_VELOCITY, true));
+  seqGateOff();
 }
 
 void seqStop() {
+  VoiceLock lock;
+  seqRecordLeds(0);
   seqState = SEQ_STOPPED;
-  digitalWrite(GATE_NOTE1, LOW);
-  gatepulse = 0;
+  seqStopClock();
+  seqGateOff();
+}
+
+uint32_t seqGateLength(const SeqStep &st) {
+  const uint32_t MIN_GATE_US = 2000UL;
+  const uint32_t MIN_GAP_US = 2000UL;
+  uint32_t gate = (seqStepMicros * st.gate) >> 7;
+  uint32_t high = (seqStepMicros > (MIN_GATE_US + MIN_GAP_US)) ? (seqStepMicros - MIN_GAP_US) : MIN_GATE_US;
+  return constrain(gate, MIN_GATE_US, high);
+}
+
+// Plays the current step and moves on, returns the timing offset of the step
+// played or SEQ_NO_STEP if there is nothing to play
+#define SEQ_NO_STEP INT16_MIN
+
+int16_t seqPlayStep() {
+  StepSeq &s = currentPlaySeq();
+  if (seqState != SEQ_PLAYING || s.length == 0) return SEQ_NO_STEP;
+
+  const SeqStep &st = s.steps[s.index];
+
+  if (st.rest) {
+    seqGateOff();
+  } else {
+    velCV = (unsigned int)((float)min(st.velocity + (st.accent ? SEQ_ACCENT_BOOST : 0), 127) * 24.43f);
+    if (seqHeld) {
+      writeNoteCV(st.note);  // legato, no retrigger
+    } else {
+      commandNote(st.note);
+    }
+    seqSlideGlide = st.slide;
+    if (st.tie || st.slide) {
+      seqGateTimer.end();
+      seqHeld = true;
+    } else {
+      seqHeld = false;
+      seqGateTimer.end();
+      seqGateTimer.begin(seqGateOff, seqGateLength(st));
+    }
+  }
+
+  int16_t micro = st.micro;
+  s.index = (s.index + 1) % s.length;
+  return micro;
+}
+
+// Step timer ISR, plays the current step and schedules the next one
+void seqStepIsr() {
+  int16_t micro = seqPlayStep();
+  if (micro == SEQ_NO_STEP) {
+    seqStepTimer.end();
+    return;
+  }
+
+  // Next step start, shifted by the difference in timing offsets
+  StepSeq &s = currentPlaySeq();
+  int32_t next = (int32_t)seqStepMicros + ((int32_t)(s.steps[s.index].micro - micro) * (int32_t)seqStepMicros) / 256;
+  seqStepTimer.end();
+  seqStepTimer.begin(seqStepIsr, (uint32_t)max(next, (int32_t)1000));
+}
+
+// External clock edge, steps land on the clock so timing offsets are ignored
+void seqClockStep() {
+  seqPlayStep();
+}
+
+void seqStartClock() {
+  seqStopClock();
+  seqHeld = false;
+  if (seqClockSource == SEQ_CLOCK_INTERNAL) seqStepTimer.begin(seqStepIsr, 100);
 }
 
 void seqPlay(uint8_t target) {
+  VoiceLock lock;
   playTarget = target;
   StepSeq &s = currentPlaySeq();
   if (s.length == 0) return;
 
+  seqRecordLeds(0);
   seqState = SEQ_PLAYING;
-  seqPhase = SEQ_GATE_OFF;
-  seqTimer = 0;
   // leave s.index as-is to "continue where stopped"
+  seqStartClock();
 }
 
 void seqContinue() {
+  VoiceLock lock;
   if (playTarget == 0) return;
   StepSeq &s = currentPlaySeq();
   if (s.length == 0) return;
 
+  seqRecordLeds(0);
   seqState = SEQ_PLAYING;
-  seqPhase = SEQ_GATE_OFF;
-  seqTimer = 0;
+  seqStartClock();
 }
 
 void seqToggleEnable() {
+  VoiceLock lock;
 
   if (seqEnabled) {
     // Prevent simultaneous ownership
     arpEnabled = false;
     arpPlaying = false;
     arpRecording = false;
+    ledPulse(BUTTON9_LED, false);
 
     seqStop();  // ensure gate is known
     seqState = SEQ_IDLE;
@@ -324,50 +691,21 @@ void seqToggleEnable() {
   }
 }
 
-void seqEngine() {
-  if (seqState != SEQ_PLAYING || playTarget == 0) return;
-
-  StepSeq &s = currentPlaySeq();
-
-  switch (seqPhase) {
-
-    case SEQ_GATE_OFF:
-      if (seqTimer >= (seqStepMicros - seqGateMicros)) {
-        seqTimer = 0;
-
-        uint8_t step = s.steps[s.index];
-
-        if (step == SEQ_REST) {
-          digitalWrite(GATE_NOTE1, LOW);
-          gatepulse = 0;
-        } else {
-          commandNote(step);  // uses your existing pitch+gate path
-        }
-
-        s.index = (s.index + 1) % s.length;
-        seqPhase = SEQ_GATE_ON;
-      }
-      break;
-
-    case SEQ_GATE_ON:
-      if (seqTimer >= seqGateMicros) {
-        digitalWrite(GATE_NOTE1, LOW);
-        gatepulse = 0;
-        seqTimer = 0;
-        seqPhase = SEQ_GATE_OFF;
-      }
-      break;
-  }
-}
-
 inline void arpGateOff() {
-  digitalWrite(GATE_NOTE1, LOW);
+  writeGate(LOW);
   gatepulse = 0;
 }
 
+void arpGateTimerIsr() {
+  arpGateTimer.end();
+  arpGateOff();
+}
+
 void arpEnable() {
+  VoiceLock lock;
   arpEnabled = true;
   arpRecording = true;
+  ledPulse(BUTTON9_LED, true);  // Pulses while the arp is recording
   arpPlaying = false;
 
   arpLength = 0;
@@ -378,12 +716,15 @@ void arpEnable() {
 }
 
 void arpStop() {
+  VoiceLock lock;
   arpPlaying = false;
   arpRecording = false;
+  ledPulse(BUTTON9_LED, false);
   arpGateOff();
 }
 
 void arpContinue() {
+  VoiceLock lock;
   if (arpLength == 0) return;
 
   arpIndex = 0;
@@ -399,6 +740,7 @@ void arpNoteInput(uint8_t note) {
   if (arpPlaying || (!arpRecording && arpEnabled)) {
     arpStop();
     arpRecording = true;
+    ledPulse(BUTTON9_LED, true);
     arpLength = 0;
     arpIndex = 0;
     firstNoteSet = false;
@@ -416,6 +758,7 @@ void arpNoteInput(uint8_t note) {
   // Re-hit first note closes sequence and starts playback
   if (note == firstArpNote && arpLength > 1) {
     arpRecording = false;
+    ledPulse(BUTTON9_LED, false);
     arpPlaying = true;
     arpIndex = 0;
     arpPhase = ARP_GATE_OFF;
@@ -429,6 +772,17 @@ void arpNoteInput(uint8_t note) {
   }
 }
 
+// External clock edge, the gate is closed by a one-shot timer
+void arpClockStep() {
+  if (!arpPlaying || arpLength == 0) return;
+
+  commandNote(arpNotes[arpIndex]);
+  arpIndex = (arpIndex + 1) % arpLength;
+
+  arpGateTimer.end();
+  arpGateTimer.begin(arpGateTimerIsr, arpGateMicros);
+}
+
 void arpEngine() {
   if (!arpPlaying || arpLength == 0) return;
 
@@ -470,70 +824,70 @@ void setVoltage(int dacpin, bool channel, bool gain, unsigned int mV) {
 }
 
 void showPatchNumberButton() {
-  srpanel.set(BUTTON1_LED, LOW);
-  srpanel.set(BUTTON2_LED, LOW);
-  srpanel.set(BUTTON3_LED, LOW);
-  srpanel.set(BUTTON4_LED, LOW);
-  srpanel.set(BUTTON5_LED, LOW);
-  srpanel.set(BUTTON6_LED, LOW);
-  srpanel.set(BUTTON7_LED, LOW);
-  srpanel.set(BUTTON8_LED, LOW);
-  srpanel.set(BUTTON9_LED, LOW);
-  srpanel.set(BUTTON10_LED, LOW);
-  srpanel.set(BUTTON11_LED, LOW);
-  srpanel.set(BUTTON12_LED, LOW);
-  srpanel.set(BUTTON13_LED, LOW);
-  srpanel.set(BUTTON14_LED, LOW);
-  srpanel.set(BUTTON15_LED, LOW);
-  srpanel.set(BUTTON16_LED, LOW);
+  ledSet(BUTTON1_LED, LOW);
+  ledSet(BUTTON2_LED, LOW);
+  ledSet(BUTTON3_LED, LOW);
+  ledSet(BUTTON4_LED, LOW);
+  ledSet(BUTTON5_LED, LOW);
+  ledSet(BUTTON6_LED, LOW);
+  ledSet(BUTTON7_LED, LOW);
+  ledSet(BUTTON8_LED, LOW);
+  ledSet(BUTTON9_LED, LOW);
+  ledSet(BUTTON10_LED, LOW);
+  ledSet(BUTTON11_LED, LOW);
+  ledSet(BUTTON12_LED, LOW);
+  ledSet(BUTTON13_LED, LOW);
+  ledSet(BUTTON14_LED, LOW);
+  ledSet(BUTTON15_LED, LOW);
+  ledSet(BUTTON16_LED, LOW);
   switch (patchNo) {
     case 1:
-      srpanel.set(BUTTON1_LED, HIGH);
+      ledSet(BUTTON1_LED, HIGH);
       break;
     case 2:
-      srpanel.set(BUTTON2_LED, HIGH);
+      ledSet(BUTTON2_LED, HIGH);
       break;
     case 3:
-      srpanel.set(BUTTON3_LED, HIGH);
+      ledSet(BUTTON3_LED, HIGH);
       break;
     case 4:
-      srpanel.set(BUTTON4_LED, HIGH);
+      ledSet(BUTTON4_LED, HIGH);
       break;
     case 5:
-      srpanel.set(BUTTON5_LED, HIGH);
+      ledSet(BUTTON5_LED, HIGH);
       break;
     case 6:
-      srpanel.set(BUTTON6_LED, HIGH);
+      ledSet(BUTTON6_LED, HIGH);
       break;
     case 7:
-      srpanel.set(BUTTON7_LED, HIGH);
+      ledSet(BUTTON7_LED, HIGH);
       break;
     case 8:
-      srpanel.set(BUTTON8_LED, HIGH);
+      ledSet(BUTTON8_LED, HIGH);
       break;
     case 9:
-      srpanel.set(BUTTON9_LED, HIGH);
+      ledSet(BUTTON9_LED, HIGH);
       break;
     case 10:
-      srpanel.set(BUTTON10_LED, HIGH);
+      ledSet(BUTTON10_LED, HIGH);
       break;
     case 11:
-      srpanel.set(BUTTON11_LED, HIGH);
+      ledSet(BUTTON11_LED, HIGH);
       break;
     case 12:
-      srpanel.set(BUTTON12_LED, HIGH);
+      ledSet(BUTTON12_LED, HIGH);
       break;
     case 13:
-      srpanel.set(BUTTON13_LED, HIGH);
+      ledSet(BUTTON13_LED, HIGH);
       break;
     case 14:
-      srpanel.set(BUTTON14_LED, HIGH);
+      ledSet(BUTTON14_LED, HIGH);
       break;
     case 15:
-      srpanel.set(BUTTON15_LED, HIGH);
+      ledSet(BUTTON15_LED, HIGH);
       break;
     case 16:
-      srpanel.set(BUTTON16_LED, HIGH);
+      ledSet(BUTTON16_LED, HIGH);
       break;
   }
 }
@@ -625,13 +979,19 @@ void stopTriggerPulse() {
   while (millis() < trigTimer + trigTimeout) {
     // wait 50 milliseconds
   }
-  digitalWrite(TRIG_NOTE1, LOW);
+  writeTrig(LOW);
   trigTimer = 0;
 }
 
 void myConvertControlChange(byte channel, byte number, byte value) {
+  TRACE_MIDI_IN(0xB0 | ((channel - 1) & 15), number);
+  if (ccLearnTarget != CC_LEARN_NONE && hiResRole[number & 127] == HR_NONE) {
+    midiLearn(channel, number);
+    return;
+  }
+  if (hiResControlChange(channel, number, value)) return;
   int newvalue = value << 3;
-  myControlChange(channel, number, newvalue);
+  midiDispatch(channel, ccRemap[(channel - 1) & 15][number & 127], newvalue);
 }
 
 void myPitchBend(byte channel, int bend) {
@@ -716,7 +1076,7 @@ void commandTopNote() {
   if (noteActive) {
     commandNote(topNote);
   } else {  // All notes are off, turn off gate
-    digitalWrite(GATE_NOTE1, LOW);
+    writeGate(LOW);
     gatepulse = 0;
   }
 }
@@ -733,7 +1093,7 @@ void commandBottomNote() {
   if (noteActive) {
     commandNote(bottomNote);
   } else {  // All notes are off, turn off gate
-    digitalWrite(GATE_NOTE1, LOW);
+    writeGate(LOW);
     gatepulse = 0;
   }
 }
@@ -748,25 +1108,30 @@ void commandLastNote() {
     }
   }
 
-  digitalWrite(GATE_NOTE1, LOW);  // All notes are off
+  writeGate(LOW);  // All notes are off
   gatepulse = 0;
 }
 
-void commandNote(int noteMsg) {
-
-  // Pitch CV
+void writeNoteCV(int noteMsg) {
   CV = (unsigned int)((float)(noteMsg + transpose + realoctave) * NOTE_SF + 0.5f);
   analogWrite(A21, CV);
   analogWrite(A22, velCV);
+  TRACE(TR_NOTE_DAC, noteMsg, CV);
+}
+
+void commandNote(int noteMsg) {
+
+  // Pitch CV
+  writeNoteCV(noteMsg);
 
   // If gate is currently OFF, start a new note (both modes)
   if (!gatepulse) {
 
     // Gate first, then trigger pulse
-    digitalWrite(GATE_NOTE1, HIGH);
+    writeGate(HIGH);
     gatepulse = true;
 
-    digitalWrite(TRIG_NOTE1, HIGH);
+    writeTrig(HIGH);
     trigTimer = millis();
 
     oldnote = noteMsg;  // establish baseline for multi-trigger comparisons
@@ -777,7 +1142,7 @@ void commandNote(int noteMsg) {
   if (multiswitch) {
     // Multi-trigger: retrigger envelope when the pitch changes
     if (oldnote != noteMsg) {
-      digitalWrite(TRIG_NOTE1, HIGH);
+      writeTrig(HIGH);
       trigTimer = millis();
       oldnote = noteMsg;
     }
@@ -788,17 +1153,22 @@ void commandNote(int noteMsg) {
 
 
 void myNoteOn(byte channel, byte note, byte velocity) {
+  TRACE_MIDI_IN(0x90 | ((channel - 1) & 15), note);
+  TRACE(TR_NOTE_ON, note, velocity);
+  VoiceLock lock;
 
   // --- Sequencer owns keyboard when enabled ---
   if (seqEnabled) {
     velCV = ((unsigned int)((float)velocity) * 24.43);
 
     if (seqState == SEQ_RECORDING) {
+      seqMarkSlide();
+
       // AUDITION
       commandNote(note);
 
       // RECORD
-      seqAppendStep(note);
+      seqAppendNote(note, velocity);
     }
     return;
   }
@@ -846,11 +1216,13 @@ void myNoteOn(byte channel, byte note, byte velocity) {
 
 
 void myNoteOff(byte channel, byte note, byte velocity) {
+  TRACE_MIDI_IN(0x80 | ((channel - 1) & 15), note);
+  VoiceLock lock;
 
   // Sequencer enabled: only honor NoteOff during RECORDING (audition release)
   if (seqEnabled) {
     if (seqState == SEQ_RECORDING) {
-      digitalWrite(GATE_NOTE1, LOW);
+      writeGate(LOW);
       gatepulse = 0;
     }
     return;
@@ -859,7 +1231,7 @@ void myNoteOff(byte channel, byte note, byte velocity) {
   // Arp enabled: only honor NoteOff during RECORDING (audition release)
   if (arpEnabled) {
     if (arpRecording) {
-      digitalWrite(GATE_NOTE1, LOW);
+      writeGate(LOW);
       gatepulse = 0;
     }
     return;
@@ -888,12 +1260,12 @@ void myNoteOff(byte channel, byte note, byte velocity) {
 }
 
 void allNotesOff() {
-  digitalWrite(GATE_NOTE1, LOW);
+  writeGate(LOW);
   gatepulse = 0;
 }
 
 void firstNoteOff() {
-  digitalWrite(GATE_NOTE1, LOW);
+  writeGate(LOW);
   gatepulse = 0;
 }
 
@@ -901,9 +1273,9 @@ void updateosc1_32() {
   if (osc1_32) {
     showCurrentParameterPage("Osc1 Footage", "32 Foot");
     osc1foot = 0;
-    srpanel.set(OSC1_32_LED, HIGH);  // LED on
-    srpanel.set(OSC1_16_LED, LOW);   // LED off
-    srpanel.set(OSC1_8_LED, LOW);    // LED off
+    ledSet(OSC1_32_LED, HIGH);  // LED on
+    ledSet(OSC1_16_LED, LOW);   // LED off
+    ledSet(OSC1_8_LED, LOW);    // LED off
   }
 }
 
@@ -911,9 +1283,9 @@ void updateosc1_16() {
   if (osc1_16) {
     showCurrentParameterPage("Osc1 Footage", "16 Foot");
     osc1foot = 2012;
-    srpanel.set(OSC1_32_LED, LOW);   // LED on
-    srpanel.set(OSC1_16_LED, HIGH);  // LED off
-    srpanel.set(OSC1_8_LED, LOW);    // LED off
+    ledSet(OSC1_32_LED, LOW);   // LED on
+    ledSet(OSC1_16_LED, HIGH);  // LED off
+    ledSet(OSC1_8_LED, LOW);    // LED off
   }
 }
 
@@ -921,18 +1293,18 @@ void updateosc1_8() {
   if (osc1_8) {
     showCurrentParameterPage("Osc1 Footage", "8 Foot");
     osc1foot = 4024;
-    srpanel.set(OSC1_32_LED, LOW);  // LED on
-    srpanel.set(OSC1_16_LED, LOW);  // LED off
-    srpanel.set(OSC1_8_LED, HIGH);  // LED off
+    ledSet(OSC1_32_LED, LOW);  // LED on
+    ledSet(OSC1_16_LED, LOW);  // LED off
+    ledSet(OSC1_8_LED, HIGH);  // LED off
   }
 }
 
 void updateosc1_saw() {
   if (osc1_saw) {
     showCurrentParameterPage("Osc1 Wave", "Sawtooth");
-    srpanel.set(OSC1_SAW_LED, HIGH);
-    srpanel.set(OSC1_TRI_LED, LOW);
-    srpanel.set(OSC1_PULSE, LOW);
+    ledSet(OSC1_SAW_LED, HIGH);
+    ledSet(OSC1_TRI_LED, LOW);
+    ledSet(OSC1_PULSE, LOW);
     boardswitch.writePin(OSC1_WAVE1, LOW);
     boardswitch.writePin(OSC1_WAVE2, LOW);
   }
@@ -941,9 +1313,9 @@ void updateosc1_saw() {
 void updateosc1_tri() {
   if (osc1_tri) {
     showCurrentParameterPage("Osc1 Wave", "Triangle");
-    srpanel.set(OSC1_SAW_LED, LOW);   // LED on
-    srpanel.set(OSC1_TRI_LED, HIGH);  // LED off
-    srpanel.set(OSC1_PULSE, LOW);     // LED off
+    ledSet(OSC1_SAW_LED, LOW);   // LED on
+    ledSet(OSC1_TRI_LED, HIGH);  // LED off
+    ledSet(OSC1_PULSE, LOW);     // LED off
     boardswitch.writePin(OSC1_WAVE1, HIGH);
     boardswitch.writePin(OSC1_WAVE2, LOW);
   }
@@ -952,9 +1324,9 @@ void updateosc1_tri() {
 void updateosc1_pulse() {
   if (osc1_pulse) {
     showCurrentParameterPage("Osc1 Wave", "Pulse");
-    srpanel.set(OSC1_SAW_LED, LOW);  // LED on
-    srpanel.set(OSC1_TRI_LED, LOW);  // LED off
-    srpanel.set(OSC1_PULSE, HIGH);   // LED off
+    ledSet(OSC1_SAW_LED, LOW);  // LED on
+    ledSet(OSC1_TRI_LED, LOW);  // LED off
+    ledSet(OSC1_PULSE, HIGH);   // LED off
     boardswitch.writePin(OSC1_WAVE1, LOW);
     boardswitch.writePin(OSC1_WAVE2, HIGH);
   }
@@ -963,12 +1335,12 @@ void updateosc1_pulse() {
 void updatemulti() {
   if (multiswitch) {
     showCurrentParameterPage("Multi Trigger", "On");
-    srpanel.set(MULTIPLE_TRIG_LED, HIGH);  // LED on
-    srpanel.set(SINGLE_TRIG_LED, LOW);     // LED off
+    ledSet(MULTIPLE_TRIG_LED, HIGH);  // LED on
+    ledSet(SINGLE_TRIG_LED, LOW);     // LED off
   } else {
     showCurrentParameterPage("Single Trigger", "On");
-    srpanel.set(SINGLE_TRIG_LED, HIGH);   // LED on
-    srpanel.set(MULTIPLE_TRIG_LED, LOW);  // LED off
+    ledSet(SINGLE_TRIG_LED, HIGH);   // LED on
+    ledSet(MULTIPLE_TRIG_LED, LOW);  // LED off
   }
 }
 
@@ -976,8 +1348,8 @@ void updatelfoTriangle() {
   if (lfoTriangle) {
     showCurrentParameterPage("LFO Waveform", "Triangle");
     LfoWave = 400;
-    srpanel.set(LFO_TRIANGLE_LED, HIGH);  // LED on
-    srpanel.set(LFO_SQUARE_LED, LOW);     // LED off
+    ledSet(LFO_TRIANGLE_LED, HIGH);  // LED on
+    ledSet(LFO_SQUARE_LED, LOW);     // LED off
   }
 }
 
@@ -985,16 +1357,16 @@ void updatelfoSquare() {
   if (lfoSquare) {
     showCurrentParameterPage("LFO Waveform", "Square");
     LfoWave = 300;
-    srpanel.set(LFO_TRIANGLE_LED, LOW);
-    srpanel.set(LFO_SQUARE_LED, HIGH);
+    ledSet(LFO_TRIANGLE_LED, LOW);
+    ledSet(LFO_SQUARE_LED, HIGH);
   }
 }
 
 void updatesyncOff() {
   if (syncOff) {
     showCurrentParameterPage("Oscillator Sync", "Off");
-    srpanel.set(SYNC_OFF_LED, HIGH);
-    srpanel.set(SYNC_ON_LED, LOW);
+    ledSet(SYNC_OFF_LED, HIGH);
+    ledSet(SYNC_ON_LED, LOW);
     boardswitch.writePin(PB_OSC1, LOW);    // pb osc1 on
     boardswitch.writePin(PB_OSC2, LOW);    // pb osc2 on
     boardswitch.writePin(SYNC, LOW);       // sync off
@@ -1005,8 +1377,8 @@ void updatesyncOff() {
 void updatesyncOn() {
   if (syncOn) {
     showCurrentParameterPage("Oscillator Sync", "On");
-    srpanel.set(SYNC_OFF_LED, LOW);
-    srpanel.set(SYNC_ON_LED, HIGH);
+    ledSet(SYNC_OFF_LED, LOW);
+    ledSet(SYNC_ON_LED, HIGH);
     boardswitch.writePin(PB_OSC1, LOW);     // pb osc1 off
     boardswitch.writePin(PB_OSC2, HIGH);    // pb osc2 on
     boardswitch.writePin(SYNC, HIGH);       // sync on
@@ -1017,8 +1389,8 @@ void updatesyncOn() {
 void updateoctave0() {
   if (octave0) {
     showCurrentParameterPage("KBD Octave", "0");
-    srpanel.set(OCTAVE_0_LED, HIGH);
-    srpanel.set(OCTAVE_1_LED, LOW);
+    ledSet(OCTAVE_0_LED, HIGH);
+    ledSet(OCTAVE_1_LED, LOW);
     boardswitch.writePin(OCTAVE, LOW);  // LED on
   }
 }
@@ -1026,8 +1398,8 @@ void updateoctave0() {
 void updateoctave1() {
   if (octave1) {
     showCurrentParameterPage("KBD Octave", "+1");
-    srpanel.set(OCTAVE_0_LED, LOW);
-    srpanel.set(OCTAVE_1_LED, HIGH);
+    ledSet(OCTAVE_0_LED, LOW);
+    ledSet(OCTAVE_1_LED, HIGH);
     boardswitch.writePin(OCTAVE, HIGH);  // LED on
   }
 }
@@ -1035,9 +1407,9 @@ void updateoctave1() {
 void updatekbOff() {
   if (kbOff) {
     showCurrentParameterPage("KBD Tracking", "Off");
-    srpanel.set(KB_OFF_LED, HIGH);
-    srpanel.set(KB_HALF_LED, LOW);
-    srpanel.set(KB_FULL_LED, LOW);
+    ledSet(KB_OFF_LED, HIGH);
+    ledSet(KB_HALF_LED, LOW);
+    ledSet(KB_FULL_LED, LOW);
     boardswitch.writePin(KEYTRACK1, LOW);
     boardswitch.writePin(KEYTRACK2, LOW);
   }
@@ -1046,9 +1418,9 @@ void updatekbOff() {
 void updatekbHalf() {
   if (kbHalf) {
     showCurrentParameterPage("KBD Tracking", "Half");
-    srpanel.set(KB_OFF_LED, LOW);
-    srpanel.set(KB_HALF_LED, HIGH);
-    srpanel.set(KB_FULL_LED, LOW);
+    ledSet(KB_OFF_LED, LOW);
+    ledSet(KB_HALF_LED, HIGH);
+    ledSet(KB_FULL_LED, LOW);
     boardswitch.writePin(KEYTRACK1, LOW);
     boardswitch.writePin(KEYTRACK2, HIGH);
   }
@@ -1057,9 +1429,9 @@ void updatekbHalf() {
 void updatekbFull() {
   if (kbFull) {
     showCurrentParameterPage("KBD Tracking", "Full");
-    srpanel.set(KB_OFF_LED, LOW);
-    srpanel.set(KB_HALF_LED, LOW);
-    srpanel.set(KB_FULL_LED, HIGH);
+    ledSet(KB_OFF_LED, LOW);
+    ledSet(KB_HALF_LED, LOW);
+    ledSet(KB_FULL_LED, HIGH);
     boardswitch.writePin(KEYTRACK1, HIGH);
     boardswitch.writePin(KEYTRACK2, HIGH);
   }
@@ -1069,9 +1441,9 @@ void updateosc2_32() {
   if (osc2_32) {
     showCurrentParameterPage("Osc2 Footage", "32 Foot");
     osc2foot = 0;
-    srpanel.set(OSC2_32_LED, HIGH);
-    srpanel.set(OSC2_16_LED, LOW);
-    srpanel.set(OSC2_8_LED, LOW);
+    ledSet(OSC2_32_LED, HIGH);
+    ledSet(OSC2_16_LED, LOW);
+    ledSet(OSC2_8_LED, LOW);
   }
 }
 
@@ -1079,9 +1451,9 @@ void updateosc2_16() {
   if (osc2_16) {
     showCurrentParameterPage("Osc2 Footage", "16 Foot");
     osc2foot = 2024;
-    srpanel.set(OSC2_32_LED, LOW);
-    srpanel.set(OSC2_16_LED, HIGH);
-    srpanel.set(OSC2_8_LED, LOW);
+    ledSet(OSC2_32_LED, LOW);
+    ledSet(OSC2_16_LED, HIGH);
+    ledSet(OSC2_8_LED, LOW);
   }
 }
 
@@ -1089,18 +1461,18 @@ void updateosc2_8() {
   if (osc2_8) {
     showCurrentParameterPage("Osc2 Footage", "8 Foot");
     osc2foot = 4048;
-    srpanel.set(OSC2_32_LED, LOW);
-    srpanel.set(OSC2_16_LED, LOW);
-    srpanel.set(OSC2_8_LED, HIGH);
+    ledSet(OSC2_32_LED, LOW);
+    ledSet(OSC2_16_LED, LOW);
+    ledSet(OSC2_8_LED, HIGH);
   }
 }
 
 void updateosc2_saw() {
   if (osc2_saw) {
     showCurrentParameterPage("Osc2 Wave", "Sawtooth");
-    srpanel.set(OSC2_SAW_LED, HIGH);
-    srpanel.set(OSC2_TRI_LED, LOW);
-    srpanel.set(OSC2_PULSE_LED, LOW);
+    ledSet(OSC2_SAW_LED, HIGH);
+    ledSet(OSC2_TRI_LED, LOW);
+    ledSet(OSC2_PULSE_LED, LOW);
     boardswitch.writePin(OSC2_WAVE1, LOW);
     boardswitch.writePin(OSC2_WAVE2, LOW);
   }
@@ -1109,9 +1481,9 @@ void updateosc2_saw() {
 void updateosc2_tri() {
   if (osc2_tri) {
     showCurrentParameterPage("Osc2 Wave", "Triangle");
-    srpanel.set(OSC2_SAW_LED, LOW);
-    srpanel.set(OSC2_TRI_LED, HIGH);
-    srpanel.set(OSC2_PULSE_LED, LOW);
+    ledSet(OSC2_SAW_LED, LOW);
+    ledSet(OSC2_TRI_LED, HIGH);
+    ledSet(OSC2_PULSE_LED, LOW);
     boardswitch.writePin(OSC2_WAVE1, HIGH);
     boardswitch.writePin(OSC2_WAVE2, LOW);
   }
@@ -1120,9 +1492,9 @@ void updateosc2_tri() {
 void updateosc2_pulse() {
   if (osc2_pulse) {
     showCurrentParameterPage("Osc2 Wave", "On");
-    srpanel.set(OSC2_SAW_LED, LOW);
-    srpanel.set(OSC2_TRI_LED, LOW);
-    srpanel.set(OSC2_PULSE_LED, HIGH);
+    ledSet(OSC2_SAW_LED, LOW);
+    ledSet(OSC2_TRI_LED, LOW);
+    ledSet(OSC2_PULSE_LED, HIGH);
     boardswitch.writePin(OSC2_WAVE1, LOW);
     boardswitch.writePin(OSC2_WAVE2, HIGH);
   }
@@ -1131,13 +1503,13 @@ void updateosc2_pulse() {
 void updatelfoOscOn() {
   if (lfoOscOnswitch) {
     showCurrentParameterPage("LFO to Osc", "On");
-    srpanel.set(LFO_OSC_OFF_LED, LOW);
-    srpanel.set(LFO_OSC_ON_LED, HIGH);
+    ledSet(LFO_OSC_OFF_LED, LOW);
+    ledSet(LFO_OSC_ON_LED, HIGH);
     boardswitch.writePin(LFO_TO_OSC, HIGH);
   } else {
     showCurrentParameterPage("LFO to Osc", "Off");
-    srpanel.set(LFO_OSC_OFF_LED, HIGH);
-    srpanel.set(LFO_OSC_ON_LED, LOW);
+    ledSet(LFO_OSC_OFF_LED, HIGH);
+    ledSet(LFO_OSC_ON_LED, LOW);
     boardswitch.writePin(LFO_TO_OSC, LOW);
   }
 }
@@ -1145,13 +1517,13 @@ void updatelfoOscOn() {
 void updatelfoVCFOn() {
   if (lfoVCFOnswitch) {
     showCurrentParameterPage("LFO to VCF", "On");
-    srpanel.set(LFO_VCF_OFF_LED, LOW);
-    srpanel.set(LFO_VCF_ON_LED, HIGH);
+    ledSet(LFO_VCF_OFF_LED, LOW);
+    ledSet(LFO_VCF_ON_LED, HIGH);
     boardswitch.writePin(LFO_TO_VCF, HIGH);
   } else {
     showCurrentParameterPage("LFO to VCF", "Off");
-    srpanel.set(LFO_VCF_OFF_LED, HIGH);
-    srpanel.set(LFO_VCF_ON_LED, LOW);
+    ledSet(LFO_VCF_OFF_LED, HIGH);
+    ledSet(LFO_VCF_ON_LED, LOW);
     boardswitch.writePin(LFO_TO_VCF, LOW);
   }
 }
@@ -1165,8 +1537,8 @@ void updatelevel1() {
     button9switch = false;
     seqToggleEnable();
     showCurrentParameterPage("Level 1", "Selected");
-    srpanel.set(LEVEL1_LED, HIGH);
-    srpanel.set(LEVEL2_LED, LOW);
+    ledSet(LEVEL1_LED, HIGH);
+    ledSet(LEVEL2_LED, LOW);
 
     showPatchNumberButton();
   }
@@ -1175,25 +1547,25 @@ void updatelevel1() {
 void updatelevel2() {
   if (level2) {
     showCurrentParameterPage("Level 2", "Selected");
-    srpanel.set(LEVEL1_LED, LOW);
-    srpanel.set(LEVEL2_LED, HIGH);
-
-    srpanel.set(BUTTON1_LED, LOW);
-    srpanel.set(BUTTON2_LED, LOW);
-    srpanel.set(BUTTON3_LED, LOW);
-    srpanel.set(BUTTON4_LED, LOW);
-    srpanel.set(BUTTON5_LED, LOW);
-    srpanel.set(BUTTON6_LED, LOW);
-    srpanel.set(BUTTON7_LED, LOW);
-    srpanel.set(BUTTON8_LED, LOW);
-    srpanel.set(BUTTON9_LED, LOW);
-    srpanel.set(BUTTON10_LED, LOW);
-    srpanel.set(BUTTON11_LED, LOW);
-    srpanel.set(BUTTON12_LED, LOW);
-    srpanel.set(BUTTON13_LED, LOW);
-    srpanel.set(BUTTON14_LED, LOW);
-    srpanel.set(BUTTON15_LED, LOW);
-    srpanel.set(BUTTON16_LED, LOW);
+    ledSet(LEVEL1_LED, LOW);
+    ledSet(LEVEL2_LED, HIGH);
+
+    ledSet(BUTTON1_LED, LOW);
+    ledSet(BUTTON2_LED, LOW);
+    ledSet(BUTTON3_LED, LOW);
+    ledSet(BUTTON4_LED, LOW);
+    ledSet(BUTTON5_LED, LOW);
+    ledSet(BUTTON6_LED, LOW);
+    ledSet(BUTTON7_LED, LOW);
+    ledSet(BUTTON8_LED, LOW);
+    ledSet(BUTTON9_LED, LOW);
+    ledSet(BUTTON10_LED, LOW);
+    ledSet(BUTTON11_LED, LOW);
+    ledSet(BUTTON12_LED, LOW);
+    ledSet(BUTTON13_LED, LOW);
+    ledSet(BUTTON14_LED, LOW);
+    ledSet(BUTTON15_LED, LOW);
+    ledSet(BUTTON16_LED, LOW);
     level1 = 0;
 
     updateshvco();
@@ -1212,13 +1584,13 @@ void updateshvco() {
   if (shvco) {
     boardswitch.writePin(SH_TO_VCO, HIGH);
     if (level2) {
-      srpanel.set(BUTTON10_LED, HIGH);
+      ledSet(BUTTON10_LED, HIGH);
     }
     button10switch = 1;
   } else {
     boardswitch.writePin(SH_TO_VCO, LOW);
     if (level2) {
-      srpanel.set(BUTTON10_LED, LOW);
+      ledSet(BUTTON10_LED, LOW);
     }
     button10switch = 0;
   }
@@ -1228,13 +1600,13 @@ void updateshvcf() {
   if (shvcf) {
     boardswitch.writePin(SH_TO_VCF, HIGH);
     if (level2) {
-      srpanel.set(BUTTON11_LED, HIGH);
+      ledSet(BUTTON11_LED, HIGH);
     }
     button11switch = 1;
   } else {
     boardswitch.writePin(SH_TO_VCF, LOW);
     if (level2) {
-      srpanel.set(BUTTON11_LED, LOW);
+      ledSet(BUTTON11_LED, LOW);
     }
     button11switch = 0;
   }
@@ -1244,13 +1616,13 @@ void updatevcfVelocity() {
   if (vcfVelocity) {
     boardswitch.writePin(VCF_VELOCITY, HIGH);
     if (level2) {
-      srpanel.set(BUTTON3_LED, HIGH);
+      ledSet(BUTTON3_LED, HIGH);
     }
     button3switch = 1;
   } else {
     boardswitch.writePin(VCF_VELOCITY, LOW);
     if (level2) {
-      srpanel.set(BUTTON3_LED, LOW);
+      ledSet(BUTTON3_LED, LOW);
     }
     button3switch = 0;
   }
@@ -1260,13 +1632,13 @@ void updatevcaVelocity() {
   if (vcaVelocity) {
     boardswitch.writePin(VCA_VELOCITY, HIGH);
     if (level2) {
-      srpanel.set(BUTTON4_LED, HIGH);
+      ledSet(BUTTON4_LED, HIGH);
     }
     button4switch = 1;
   } else {
     boardswitch.writePin(VCA_VELOCITY, LOW);
     if (level2) {
-      srpanel.set(BUTTON4_LED, LOW);
+      ledSet(BUTTON4_LED, LOW);
     }
     button4switch = 0;
   }
@@ -1276,13 +1648,13 @@ void updatevcfLoop() {
   if (vcfLoop) {
     boardswitch.writePin(VCF_LOOP, HIGH);
     if (level2) {
-      srpanel.set(BUTTON5_LED, HIGH);
+      ledSet(BUTTON5_LED, HIGH);
     }
     button5switch = 1;
   } else {
     boardswitch.writePin(VCF_LOOP, LOW);
     if (level2) {
-      srpanel.set(BUTTON5_LED, LOW);
+      ledSet(BUTTON5_LED, LOW);
     }
     button5switch = 0;
   }
@@ -1292,13 +1664,13 @@ void updatevcaLoop() {
   if (vcaLoop) {
     boardswitch.writePin(VCA_LOOP, HIGH);
     if (level2) {
-      srpanel.set(BUTTON6_LED, HIGH);
+      ledSet(BUTTON6_LED, HIGH);
     }
     button6switch = 1;
   } else {
     boardswitch.writePin(VCA_LOOP, LOW);
     if (level2) {
-      srpanel.set(BUTTON6_LED, LOW);
+      ledSet(BUTTON6_LED, LOW);
     }
     button6switch = 0;
   }
@@ -1308,13 +1680,13 @@ void updatevcfLinear() {
   if (vcfLinear) {
     boardswitch.writePin(VCF_LOG_LIN, HIGH);
     if (level2) {
-      srpanel.set(BUTTON7_LED, HIGH);
+      ledSet(BUTTON7_LED, HIGH);
     }
     button7switch = 1;
   } else {
     boardswitch.writePin(VCF_LOG_LIN, LOW);
     if (level2) {
-      srpanel.set(BUTTON7_LED, LOW);
+      ledSet(BUTTON7_LED, LOW);
     }
     button7switch = 0;
   }
@@ -1324,13 +1696,13 @@ void updatevcaLinear() {
   if (vcaLinear) {
     boardswitch.writePin(VCA_LOG_LIN, HIGH);
     if (level2) {
-      srpanel.set(BUTTON8_LED, HIGH);
+      ledSet(BUTTON8_LED, HIGH);
     }
     button8switch = 1;
   } else {
     boardswitch.writePin(VCA_LOG_LIN, LOW);
     if (level2) {
-      srpanel.set(BUTTON8_LED, LOW);
+      ledSet(BUTTON8_LED, LOW);
     }
     button8switch = 0;
   }
@@ -1340,14 +1712,14 @@ void updateextclock() {
   if (!clocksource) {
     boardswitch.writePin(CLOCK_SOURCE, LOW);
     if (level2) {
-      srpanel.set(BUTTON12_LED, HIGH);
-      srpanel.set(BUTTON13_LED, LOW);
+      ledSet(BUTTON12_LED, HIGH);
+      ledSet(BUTTON13_LED, LOW);
     }
   } else {
     boardswitch.writePin(CLOCK_SOURCE, HIGH);
     if (level2) {
-      srpanel.set(BUTTON13_LED, HIGH);
-      srpanel.set(BUTTON12_LED, LOW);
+      ledSet(BUTTON13_LED, HIGH);
+      ledSet(BUTTON12_LED, LOW);
     }
   }
 }
@@ -1365,8 +1737,8 @@ void updatebutton1() {
     seqResetRecord(1);
   }
   if (level2 && button1switch && !seqEnabled) {
-    srpanel.set(BUTTON1_LED, HIGH);
-    srpanel.set(BUTTON2_LED, LOW);
+    ledSet(BUTTON1_LED, HIGH);
+    ledSet(BUTTON2_LED, LOW);
     button2switch = 0;
     state = SETTINGS;
     settings::reset_settings();
@@ -1376,7 +1748,7 @@ void updatebutton1() {
     showSettingsPage();
   }
   if (level2 && !button1switch && !seqEnabled) {
-    srpanel.set(BUTTON1_LED, LOW);
+    ledSet(BUTTON1_LED, LOW);
     state = PARAMETER;
   }
   if (level1) {
@@ -1391,8 +1763,8 @@ void updatebutton2() {
     seqResetRecord(2);
   }
   if (level2 && button2switch && !seqEnabled) {
-    srpanel.set(BUTTON2_LED, HIGH);
-    srpanel.set(BUTTON1_LED, LOW);
+    ledSet(BUTTON2_LED, HIGH);
+    ledSet(BUTTON1_LED, LOW);
     button1switch = 0;
     state = SETTINGS;
     settings::reset_settings();
@@ -1403,7 +1775,7 @@ void updatebutton2() {
     showSettingsPage();
   }
   if (level2 && !button2switch && !seqEnabled) {
-    srpanel.set(BUTTON2_LED, LOW);
+    ledSet(BUTTON2_LED, LOW);
     state = PARAMETER;
   }
   if (level1) {
@@ -1414,11 +1786,11 @@ void updatebutton2() {
 
 void turnOffOneandTwo() {
   if (button1switch) {
-    srpanel.set(BUTTON1_LED, LOW);
+    ledSet(BUTTON1_LED, LOW);
     button1switch = 0;
   }
   if (button2switch) {
-    srpanel.set(BUTTON2_LED, LOW);
+    ledSet(BUTTON2_LED, LOW);
     button2switch = 0;
   }
 }
@@ -1435,14 +1807,14 @@ void updatebutton3() {
   if (level2 && button3switch && !arpEnabled && !seqEnabled) {
     showCurrentParameterPage("VCF Vel", "On");
     vcfVelocity = 1;
-    srpanel.set(BUTTON3_LED, HIGH);
+    ledSet(BUTTON3_LED, HIGH);
     turnOffOneandTwo();
     boardswitch.writePin(VCF_VELOCITY, HIGH);
   }
   if (level2 && !button3switch && !arpEnabled && !seqEnabled) {
     showCurrentParameterPage("VCF Vel", "Off ");
     vcfVelocity = 0;
-    srpanel.set(BUTTON3_LED, LOW);
+    ledSet(BUTTON3_LED, LOW);
     turnOffOneandTwo();
     boardswitch.writePin(VCF_VELOCITY, LOW);
   }
@@ -1464,14 +1836,14 @@ void updatebutton4() {
   if (level2 && button4switch && !arpEnabled && !seqEnabled) {
     showCurrentParameterPage("VCA Vel", "On");
     vcaVelocity = 1;
-    srpanel.set(BUTTON4_LED, HIGH);
+    ledSet(BUTTON4_LED, HIGH);
     turnOffOneandTwo();
     boardswitch.writePin(VCA_VELOCITY, HIGH);
   }
   if (level2 && !button4switch && !arpEnabled && !seqEnabled) {
     showCurrentParameterPage("VCA Vel", "Off ");
     vcaVelocity = 0;
-    srpanel.set(BUTTON4_LED, LOW);
+    ledSet(BUTTON4_LED, LOW);
     turnOffOneandTwo();
     boardswitch.writePin(VCA_VELOCITY, LOW);
   }
@@ -1489,14 +1861,14 @@ void updatebutton5() {
   if (level2 && button5switch && !seqEnabled) {
     showCurrentParameterPage("VCF Loop", "On");
     vcfLoop = 1;
-    srpanel.set(BUTTON5_LED, HIGH);
+    ledSet(BUTTON5_LED, HIGH);
     turnOffOneandTwo();
     boardswitch.writePin(VCF_LOOP, HIGH);
   }
   if (level2 && !button5switch && !seqEnabled) {
     showCurrentParameterPage("VCF Loop", "Off ");
     vcfLoop = 0;
-    srpanel.set(BUTTON5_LED, LOW);
+    ledSet(BUTTON5_LED, LOW);
     turnOffOneandTwo();
     boardswitch.writePin(VCF_LOOP, LOW);
   }
@@ -1514,14 +1886,14 @@ void updatebutton6() {
   if (level2 && button6switch && !seqEnabled) {
     showCurrentParameterPage("VCA Loop", "On");
     vcaLoop = 1;
-    srpanel.set(BUTTON6_LED, HIGH);
+    ledSet(BUTTON6_LED, HIGH);
     turnOffOneandTwo();
     boardswitch.writePin(VCA_LOOP, HIGH);
   }
   if (level2 && !button6switch && !seqEnabled) {
     showCurrentParameterPage("VCA Loop", "Off ");
     vcaLoop = 0;
-    srpanel.set(BUTTON6_LED, LOW);
+    ledSet(BUTTON6_LED, LOW);
     turnOffOneandTwo();
     boardswitch.writePin(VCA_LOOP, LOW);
   }
@@ -1541,14 +1913,14 @@ void updatebutton7() {
   if (level2 && button7switch && !seqEnabled) {
     showCurrentParameterPage("VCF Lin EG", "On");
     vcfLinear = 1;
-    srpanel.set(BUTTON7_LED, HIGH);
+    ledSet(BUTTON7_LED, HIGH);
     turnOffOneandTwo();
     boardswitch.writePin(VCF_LOG_LIN, HIGH);
   }
   if (level2 && !button7switch && !seqEnabled) {
     showCurrentParameterPage("VCF Lin EG", "Off ");
     vcfLinear = 0;
-    srpanel.set(BUTTON7_LED, LOW);
+    ledSet(BUTTON7_LED, LOW);
     turnOffOneandTwo();
     boardswitch.writePin(VCF_LOG_LIN, LOW);
   }
@@ -1562,14 +1934,14 @@ void updatebutton8() {
   if (level2 && button8switch) {
     showCurrentParameterPage("VCA Lin EG", "On");
     vcaLinear = 1;
-    srpanel.set(BUTTON8_LED, HIGH);
+    ledSet(BUTTON8_LED, HIGH);
     turnOffOneandTwo();
     boardswitch.writePin(VCA_LOG_LIN, HIGH);
   }
   if (level2 && !button8switch) {
     showCurrentParameterPage("VCA Lin EG", "Off ");
     vcaLinear = 0;
-    srpanel.set(BUTTON8_LED, LOW);
+    ledSet(BUTTON8_LED, LOW);
     turnOffOneandTwo();
     boardswitch.writePin(VCA_LOG_LIN, LOW);
   }
@@ -1582,15 +1954,16 @@ void updatebutton8() {
 void updatebutton9() {
   if (level2 && button9switch) {
     showCurrentParameterPage("Arpeggiator", "On");
-    srpanel.set(BUTTON9_LED, HIGH);
+    ledSet(BUTTON9_LED, HIGH);
     arpEnable();
   }
   if (level2 && !button9switch) {
     showCurrentParameterPage("Arpeggiator", "Off ");
-    srpanel.set(BUTTON9_LED, LOW);
+    ledSet(BUTTON9_LED, LOW);
     arpStop();
     arpEnabled = false;
     arpRecording = false;
+    ledPulse(BUTTON9_LED, false);
     arpPlaying = false;
   }
   if (level1) {
@@ -1602,13 +1975,13 @@ void updatebutton9() {
 void updatebutton10() {
   if (level2 && button10switch) {
     showCurrentParameterPage("Sample & Hold", "To VCO");
-    srpanel.set(BUTTON10_LED, HIGH);
+    ledSet(BUTTON10_LED, HIGH);
     turnOffOneandTwo();
     boardswitch.writePin(SH_TO_VCO, HIGH);
   }
   if (level2 && !button10switch) {
     showCurrentParameterPage("Sample & Hold", "Off ");
-    srpanel.set(BUTTON10_LED, LOW);
+    ledSet(BUTTON10_LED, LOW);
     turnOffOneandTwo();
     boardswitch.writePin(SH_TO_VCO, LOW);
   }
@@ -1621,13 +1994,13 @@ void updatebutton10() {
 void updatebutton11() {
   if (level2 && button11switch) {
     showCurrentParameterPage("Sample & Hold", "To VCF ");
-    srpanel.set(BUTTON11_LED, HIGH);
+    ledSet(BUTTON11_LED, HIGH);
     turnOffOneandTwo();
     boardswitch.writePin(SH_TO_VCF, HIGH);
   }
   if (level2 && !button11switch) {
     showCurrentParameterPage("Sample & Hold", "Off ");
-    srpanel.set(BUTTON11_LED, LOW);
+    ledSet(BUTTON11_LED, LOW);
     turnOffOneandTwo();
     boardswitch.writePin(SH_TO_VCF, LOW);
   }
@@ -1640,8 +2013,8 @@ void updatebutton11() {
 void updatebutton12() {
   if (level2 && button12switch) {
     showCurrentParameterPage("LFO Sync", "External");
-    srpanel.set(BUTTON12_LED, HIGH);
-    srpanel.set(BUTTON13_LED, LOW);
+    ledSet(BUTTON12_LED, HIGH);
+    ledSet(BUTTON13_LED, LOW);
     boardswitch.writePin(CLOCK_SOURCE, LOW);
     clocksource = 0;
     storeClockSource(clocksource);
@@ -1657,8 +2030,8 @@ void updatebutton12() {
 void updatebutton13() {
   if (level2 && button13switch) {
     showCurrentParameterPage("LFO Sync", "MIDI");
-    srpanel.set(BUTTON13_LED, HIGH);
-    srpanel.set(BUTTON12_LED, LOW);
+    ledSet(BUTTON13_LED, HIGH);
+    ledSet(BUTTON12_LED, LOW);
     boardswitch.writePin(CLOCK_SOURCE, HIGH);
     clocksource = 1;
     storeClockSource(clocksource);
@@ -1674,13 +2047,13 @@ void updatebutton13() {
 void updatebutton14() {
   if (level2 && button14switch) {
     showCurrentParameterPage("Sequencer", "On");
-    srpanel.set(BUTTON14_LED, HIGH);
+    ledSet(BUTTON14_LED, HIGH);
     seqEnabled = true;
     seqToggleEnable();
   }
   if (level2 && !button14switch) {
     showCurrentParameterPage("Sequencer", "Off ");
-    srpanel.set(BUTTON14_LED, LOW);
+    ledSet(BUTTON14_LED, LOW);
     seqStop();
     seqEnabled = false;
     seqToggleEnable();
@@ -1692,7 +2065,10 @@ void updatebutton14() {
 }
 
 void updatebutton15() {
-  if (level2) {
+  if (level2 && seqEnabled) {
+    showCurrentParameterPage("Step Tie", seqToggleTie() ? "On" : "Off");
+  }
+  if (level2 && !seqEnabled) {
     showCurrentParameterPage("Level 2", "No Function");
     turnOffOneandTwo();
   }
@@ -1703,7 +2079,10 @@ void updatebutton15() {
 }
 
 void updatebutton16() {
-  if (level2) {
+  if (level2 && seqEnabled) {
+    showCurrentParameterPage("Step Accent", seqToggleAccent() ? "On" : "Off");
+  }
+  if (level2 && !seqEnabled) {
     showCurrentParameterPage("Level 2", "No Function");
     turnOffOneandTwo();
   }
@@ -1737,23 +2116,20 @@ void updateFilterCutoff() {
   showCurrentParameterPage("Cutoff", String(filterCutoffstr) + " Hz");
 }
 
-void updateLfoRate() {
-
-  // --- USER-TUNABLE LIMITS ---
-  const float minHz = 0.5f;
-  const float maxHz = 20.0f;
-
-  // Normalize 0–1024 → 0.0–1.0
-  float norm = (float)constrain(LfoRate, 0, 1024) / 1024.0f;
-
-  // Exponential mapping (one rate drives both ARP + SEQ)
-  float rateHz = minHz * powf(maxHz / minHz, norm);
+// One rate drives both ARP + SEQ, exponential 0.5Hz to 20Hz over the pot
+uint32_t lfoStepMicros() {
+  uint32_t pos = constrain(LfoRate, 0, 1024);
+  uint32_t i = pos >> 3;
+  if (i >= 128) return LFO_STEP_US[128];
+  uint32_t a = LFO_STEP_US[i];
+  return a - (((a - LFO_STEP_US[i + 1]) * (pos & 7)) >> 3);
+}
 
-  // Convert to step timing
-  uint32_t stepMicros = (uint32_t)(1000000.0f / rateHz);
+// Step length for the arp and sequencer, from the LFO rate or the external clock
+void setSeqStepTiming(uint32_t stepMicros) {
 
   // Compute 80% duty gate
-  uint32_t gateMicros = (uint32_t)((float)stepMicros * 0.80f);
+  uint32_t gateMicros = (stepMicros / 5) * 4;
 
   // Safety clamp (typed + underflow-safe)
   const uint32_t MIN_GATE_US = 2000UL;
@@ -1769,9 +2145,28 @@ void updateLfoRate() {
   arpStepMicros = stepMicros;
   arpGateMicros = gateMicros;
 
-  // Apply to Sequencer
+  // Apply to Sequencer, gate lengths are per step
   seqStepMicros = stepMicros;
-  seqGateMicros = gateMicros;
+}
+
+void seqClockSourceChanged() {
+  arpGateTimer.end();
+  extClockSubTimer.end();
+  if (seqClockSource == SEQ_CLOCK_INTERNAL) {
+    setSeqStepTiming(lfoStepMicros());
+    arpPhase = ARP_GATE_OFF;
+    arpTimer = 0;
+  }
+  if (seqState == SEQ_PLAYING) seqStartClock();
+}
+
+void updateLfoRate() {
+
+  uint32_t stepMicros = lfoStepMicros();
+  float rateHz = 1000000.0f / stepMicros;
+
+  // The external clock sets the step timing while it is selected
+  if (seqClockSource == SEQ_CLOCK_INTERNAL) setSeqStepTiming(stepMicros);
 
   // Display priority: ARP, then SEQ, else LFO
   if (arpEnabled) {
@@ -1877,15 +2272,28 @@ void updatefilterRelease() {
 }
 
 
+void updatemodRate(const char *name, int value) {
+  showCurrentParameterPage(name, int(value / 8));
+}
+
+void updatemodDepth(uint8_t slot) {
+  showCurrentParameterPage(MOD_DEPTH_NAMES[slot], int(modRoutes[slot].depth / 256));
+}
+
 void updatePatchname() {
   showPatchPage(String(patchNo), patchName);
 }
 
 void myControlChange(byte channel, byte control, int value) {
+  if (!ccFromMidi) {
+    if (ccLearnMode) midiLearnArm(control);
+    midiOutQueue(control, value);
+  }
 
   switch (control) {
 
     case CCmodwheel:
+      morphSetPosition(value);
       switch (modWheelDepth) {
         case 0:
           modulation = 0;
@@ -2491,14 +2899,14 @@ void myControlChange(byte channel, byte control, int value) {
       break;
 
     case CCLfoRate:
-      LfoRatestr = LFOTEMPO[value / 8];  // for display
+      LfoRatestr = LFOTEMPO_MHZ[value / 8] / 1000.0f;  // for display
       LfoRate = value;
       updateLfoRate();
       break;
 
     case CCpwLFO:
       pwLFO = value;
-      pwLFOstr = LFOTEMPO[value / 8];  // for display
+      pwLFOstr = LFOTEMPO_MHZ[value / 8] / 1000.0f;  // for display
       updatepwLFO();
       break;
 
@@ -2572,6 +2980,55 @@ void myControlChange(byte channel, byte control, int value) {
       updatefilterRelease();
       break;
 
+    case CCmodLfo3Rate:
+      modSetLfoRate(0, value);
+      updatemodRate("Mod LFO3 Rate", value);
+      break;
+
+    case CCmodLfo4Rate:
+      modSetLfoRate(1, value);
+      updatemodRate("Mod LFO4 Rate", value);
+      break;
+
+    case CCmodEnvRate:
+      modSetEnvRate(value);
+      updatemodRate("Mod Env Rate", value);
+      break;
+
+    case CCmodSHRate:
+      modSetShRate(value);
+      updatemodRate("Mod S&H Rate", value);
+      break;
+
+    case CCmodDepth1:
+    case CCmodDepth2:
+    case CCmodDepth3:
+    case CCmodDepth4:
+      modSetDepth(control - CCmodDepth1, value);
+      updatemodDepth(control - CCmodDepth1);
+      break;
+
+    case CCmorphPatch:
+      showCurrentParameterPage("Morph to", String((value >> 3) + 1));
+      morphStart((value >> 3) + 1);
+      break;
+
+    case CCmorphPosition:
+      morphSetPosition(value);
+      break;
+
+    case CCpatchCompare:
+      patchCompare(value >= 512);
+      break;
+
+    case CCpatchUndo:
+      if (value >= 512) patchUndoLoad();
+      break;
+
+    case CCbankSelect:
+      if ((value >> 3) <= PATCH_BANKS) midiBank = value >> 3;  // Banks that don't exist keep the current one
+      break;
+
     case CCallnotesoff:
       allNotesOff();
       break;
@@ -2581,112 +3038,173 @@ void myControlChange(byte channel, byte control, int value) {
 void myProgramChange(byte channel, byte program) {
   state = PATCH;
   patchNo = program + 1;
-  recallPatch(patchNo);
+  if (midiBank != patchBank) {
+    selectBank(midiBank, patchNo);
+  } else {
+    recallPatch(patchNo);
+  }
   Serial.print("MIDI Pgm Change:");
   Serial.println(patchNo);
   state = PARAMETER;
 }
 
 void recallPatch(int patchNo) {
-  allNotesOff();
-  level1 = true;
-  updatelevel1();
+  browsePending = false;  //A direct recall replaces any browse still waiting
+  morphStop();
+  loadPatch(patchNo, LOAD_RECALL);
+}
+
+//The patch is loaded straight from its file, as at boot, and the bank is
+//indexed from loop() afterwards. patchIndexDone() falls back to the bank's
+//first patch if there is no such patch.
+void selectBank(uint8_t bank, int patch) {
+  if (bank == patchBank && patchIndexReady) {
+    recallPatch(patch);
+    return;
+  }
+  patchBank = bank;
+  midiBank = bank;
+  storePatchBank(bank);
+  if (!cardStatus) return;
+  if (bank > 0) SD.mkdir(bankDir(bank).c_str());
+
+  browsePending = false;
+  morphStop();
+  patchNo = patch;
+  bootPatchLoaded = loadPatch(patchNo, LOAD_RECALL);
+  startPatchIndex();
 
-  File patchFile = SD.open(String(patchNo).c_str());
+  char name[PATCH_NAME_MAX + 1];
+  bankName(bank, name, sizeof(name));
+  showCurrentParameterPage("Bank", String(name));
+}
+
+// Patch apply transaction
+//
+// setCurrentPatchData() only changes globals, boardswitch bits and the LED
+// frame. commitPatchTx() then latches the routing and LEDs once each and
+// writes every demux channel in one burst, instead of the CVs trickling out
+// one channel per loop over the next 16 loops.
+//
+// With "Patch Change" set to "Note Off" the playing note keeps the old sound
+// and the commit waits for the gate to close. The loaded values wait in
+// patchPending meanwhile, so loop() keeps refreshing the old patch, bend and
+// mod wheel CVs and the pots still work.
+#define PATCH_TX_GATE_TIMEOUT_MS 2000
+
+boolean patchTxOpen = false;
+boolean patchTxHeld = false;
+elapsedMillis patchTxGateTimer;
+
+void beginPatchTx() {
+  patchTxOpen = true;
+  patchTxGateTimer = 0;
+}
+
+boolean patchTxGateHeld() {
+  return patchSyncGate && digitalReadFast(GATE_NOTE1) && patchTxGateTimer < PATCH_TX_GATE_TIMEOUT_MS;
+}
+
+// Puts the old sound back until the gate closes
+void holdPatchTx() {
+  patchSnapshot(patchPending, patch);
+  patchSnapshot(patch, patchUndo);
+  applyPatchState();
+  patchTxHeld = true;
+}
+
+void commitPatchTx() {
+  if (patchTxHeld) {
+    patchSnapshot(patch, patchPending);
+    applyPatchState();
+    autosaveRebase();
+    patchTxHeld = false;
+  }
+  boardswitch.update();
+  flushLeds();
+  for (int i = 0; i < DEMUXCHANNELS; i++) {
+    writeDemux();
+  }
+  patchTxOpen = false;
+  TRACE(TR_PATCH_END, 0, patchNo);
+}
+
+void checkPatchTx() {
+  if (!patchTxOpen) return;
+  if (patchTxGateHeld()) return;
+  commitPatchTx();
+}
+
+//Browsing loads give up if the encoder has moved on while the file was read,
+//before anything on the panel is changed
+bool loadPatch(int patchNo, PatchLoad load) {
+  TRACE(TR_PATCH_START, 0, patchNo);
+  File patchFile = SD.open(patchPath(patchNo).c_str());
   if (!patchFile) {
     Serial.println("File not found");
-    return;
+    return false;
   }
 
-  String data[NO_OF_PARAMS];  // NO_OF_PARAMS must be >= 196 for seq support
-  int fields = recallPatchData(patchFile, data);
-  patchFile.close();
+  //The first block holds all but the sequences, most of the SD time is here
+  PatchReader reader(patchFile);
+  reader.peek();
+
+  if (load == LOAD_BROWSE && abs(encoder.read() - encPrevious) > 3) {
+    patchFile.close();
+    return false;
+  }
 
-  setCurrentPatchData(data, fields);
+  beginPatchTx();
+  if (!patchSyncGate && load != LOAD_MORPH) allNotesOff();
+  level1 = true;
+  updatelevel1();
+
+  if (patchComparing) patchCompare(false);
+  patchSnapshot(patchUndo, patch);
+  setCurrentPatchData(reader);
+  patchFile.close();
+  patchSnapshot(patchStored, patch);
+  if (load == LOAD_MORPH) morphCapture();
 
   storeLastPatch(patchNo);
+  autosaveRebase();
   showPatchNumberButton();
   //updatelevel2();
+  if (load != LOAD_MORPH && patchTxGateHeld()) holdPatchTx();
+  checkPatchTx();
+  return true;
 }
 
-void setCurrentPatchData(String data[], int fields) {
-  patchName = data[0];
-  noiseLevel = data[1].toInt();
-  glide = data[2].toInt();
-  osc1_32 = data[3].toInt();
-  osc1_16 = data[4].toInt();
-  osc1_8 = data[5].toInt();
-  osc1_saw = data[6].toInt();
-  osc1_tri = data[7].toInt();
-  osc1_pulse = data[8].toInt();
-  osc2_32 = data[9].toInt();
-  osc2_16 = data[10].toInt();
-  osc2_8 = data[11].toInt();
-  osc2_saw = data[12].toInt();
-  osc2_tri = data[13].toInt();
-  osc2_pulse = data[14].toInt();
-  single = data[15].toInt();
-  multiswitch = data[16].toInt();
-  lfoTriangle = data[17].toInt();
-  lfoSquare = data[18].toInt();
-  lfoOscOffswitch = data[19].toInt();
-  lfoOscOnswitch = data[20].toInt();
-  lfoVCFOffswitch = data[21].toInt();
-  lfoVCFOnswitch = data[22].toInt();
-  syncOff = data[23].toInt();
-  syncOn = data[24].toInt();
-  kbOff = data[25].toInt();
-  kbHalf = data[26].toInt();
-  kbFull = data[27].toInt();
-  LfoRate = data[28].toInt();
-  pwLFO = data[29].toFloat();
-  osc1level = data[30].toInt();
-  osc2level = data[31].toInt();
-  osc1PW = data[32].toInt();
-  osc2PW = data[33].toInt();
-  osc1PWM = data[34].toInt();
-  osc2PWM = data[35].toInt();
-  ampAttack = data[36].toInt();
-  ampDecay = data[37].toInt();
-  ampSustain = data[38].toInt();
-  ampRelease = data[39].toInt();
-  osc2interval = data[40].toInt();
-  filterAttack = data[41].toInt();
-  filterDecay = data[42].toInt();
-  filterSustain = data[43].toInt();
-  filterRelease = data[44].toInt();
-  filterRes = data[45].toInt();
-  filterCutoff = data[46].toFloat();
-  filterLevel = data[47].toInt();
-  osc1foot = data[48].toInt();
-  osc2foot = data[49].toInt();
-  octave0 = data[50].toInt();
-  octave1 = data[51].toInt();
-  shvco = data[52].toInt();
-  shvcf = data[53].toInt();
-  vcfVelocity = data[54].toInt();
-  vcaVelocity = data[55].toInt();
-  vcfLoop = data[56].toInt();
-  vcaLoop = data[57].toInt();
-  vcfLinear = data[58].toInt();
-  vcaLinear = data[59].toInt();
-  keyMode = data[60].toInt();
-  modWheelDepth = data[61].toInt();
-  pitchBendRange = data[62].toInt();
-  volume = data[63].toInt();
-  clocksource = data[64].toInt();
-  afterTouchDepth = data[65].toInt();
-
-  // AfterTouch is data[65]
-  int idx = 66;  // next field after your existing patch params
+//Move through the patch list showing names only, faster turns skip further
+void browsePatches(bool forward) {
+  int steps = 1;
+  if (encStepTimer < BROWSE_FAST_MS) steps = 5;
+  else if (encStepTimer < BROWSE_MEDIUM_MS) steps = 2;
+  encStepTimer = 0;
 
-  // Optional sequencer data (backward compatible)
-  csvToSeq(seq1, data, idx, fields);
-  csvToSeq(seq2, data, idx, fields);
-  seq1.index = 0;
-  seq2.index = 0;
+  for (int i = 0; i < steps; i++) {
+    if (forward) patches.next();
+    else patches.prev();
+  }
+  showPatchPage(String(patches.first().patchNo), patches.first().patchName);
+  timer = 0;  //Show the patch page rather than the last parameter
+  browsePending = true;
+  browseTimer = 0;
+}
+
+void checkBrowse() {
+  if (!browsePending || browseTimer < browseDelay || state != PARAMETER) return;
+  browsePending = false;
+  morphStop();
+  state = PATCH;
+  patchNo = patches.first().patchNo;
+  loadPatch(patchNo, LOAD_BROWSE);
+  state = PARAMETER;
+}
 
-  //Switches
+// Switch outputs and LEDs follow the patch state, the pots are picked up by
+// writeDemux() from the values themselves
+void applyPatchState() {
   updateosc1_32();
   updateosc1_16();
   updateosc1_8();
@@ -2720,7 +3238,70 @@ void setCurrentPatchData(String data[], int fields) {
   updatevcfLinear();
   updatevcaLinear();
   updateextclock();
+}
+
+void patchSnapshot(PatchState &to, const PatchState &from) {
+  memcpy(&to, &from, sizeof(PatchState));
+}
+
+// Edited since the last load or save
+boolean patchEdited() {
+  const uint32_t *a = (const uint32_t *)&patch;
+  const uint32_t *b = (const uint32_t *)&patchStored;
+  for (unsigned int i = 0; i < sizeof(PatchState) / 4; i++) {
+    if (a[i] != b[i]) return true;
+  }
+  return false;
+}
+
+void patchSwap(PatchState &other) {
+  PatchState held;
+  patchSnapshot(held, patch);
+  patchSnapshot(patch, other);
+  patchSnapshot(other, held);
+  applyPatchState();
+}
+
+// What is saved is what is heard, compare or not
+void patchSaved() {
+  patchSnapshot(patchStored, patch);
+  patchComparing = false;
+  autosaveRebase();
+}
+
+// Flips between the edited sound and the stored one, the edits are kept
+// in patchStored meanwhile
+void patchCompare(boolean on) {
+  if (on == patchComparing) return;
+  if (on && !patchEdited()) {
+    showCurrentParameterPage("Compare", "No edits");
+    return;
+  }
+  patchSwap(patchStored);
+  patchComparing = on;
+  showCurrentParameterPage("Compare", on ? "Stored" : "Edited");
+}
+
+// Back to the sound before the last patch load, again to redo
+void patchUndoLoad() {
+  if (patchComparing) patchCompare(false);
+  patchSwap(patchUndo);
+  showCurrentParameterPage("Undo", "Patch load");
+}
+
+void setCurrentPatchData(PatchReader &reader) {
+  char name[32];
+  reader.readText(name, sizeof(name));
+  patchName = name;
+  readPatchFields(reader, patch);
+
+  // Optional sequencer data (backward compatible)
+  readSeq(seq1, reader);
+  readSeq(seq2, reader);
+  seq1.index = 0;
+  seq2.index = 0;
 
+  applyPatchState();
 
   //Patchname
   updatePatchname();
@@ -2730,17 +3311,15 @@ void setCurrentPatchData(String data[], int fields) {
 }
 
 String getCurrentPatchData() {
-  return patchName + "," + String(noiseLevel) + "," + String(glide) + "," + String(osc1_32) + "," + String(osc1_16) + "," + String(osc1_8) + "," + String(osc1_saw) + "," + String(osc1_tri)
-         + "," + String(osc1_pulse) + "," + String(osc2_32) + "," + String(osc2_16) + "," + String(osc2_8) + "," + String(osc2_saw) + "," + String(osc2_tri) + "," + String(osc2_pulse) + "," + String(singleswitch)
-         + "," + String(multiswitch) + "," + String(lfoTriangle) + "," + String(lfoSquare) + "," + String(lfoOscOffswitch) + "," + String(lfoOscOnswitch) + "," + String(lfoVCFOffswitch)
-         + "," + String(lfoVCFOnswitch) + "," + String(syncOff) + "," + String(syncOn) + "," + String(kbOff) + "," + String(kbHalf) + "," + String(kbFull) + "," + String(LfoRate)
-         + "," + String(pwLFO) + "," + String(osc1level) + "," + String(osc2level) + "," + String(osc1PW) + "," + String(osc2PW) + "," + String(osc1PWM) + "," + String(osc2PWM)
-         + "," + String(ampAttack) + "," + String(ampDecay) + "," + String(ampSustain) + "," + String(ampRelease) + "," + String(osc2interval) + "," + String(filterAttack)
-         + "," + String(filterDecay) + "," + String(filterSustain) + "," + String(filterRelease) + "," + String(filterRes) + "," + String(filterCutoff) + "," + String(filterLevel)
-         + "," + String(osc1foot) + "," + String(osc2foot) + "," + String(octave0) + "," + String(octave1) + "," + String(shvco) + "," + String(shvcf) + "," + String(vcfVelocity)
-         + "," + String(vcaVelocity) + "," + String(vcfLoop) + "," + String(vcaLoop) + "," + String(vcfLinear) + "," + String(vcaLinear) + "," + String(keyMode) + "," + String(modWheelDepth)
-         + "," + String(pitchBendRange) + "," + String(volume) + "," + String(clocksource) + "," + String(afterTouchDepth) + "," + seqToCsv(seq1) + "," + seqToCsv(seq2);
-  ;
+  String data;
+  data.reserve(PATCH_FIELD_COUNT * 5 + 128);
+  data += patchName;
+  writePatchFields(data, patch);
+  data += ',';
+  data += seqField(seq1);
+  data += ',';
+  data += seqField(seq2);
+  return data;
 }
 
 void checkMux() {
@@ -2879,16 +3458,16 @@ void writeDemux() {
       setVoltage(DAC_NOTE1, 1, 1, int(noiseLevel * 2));
       break;
     case 8:  // 10 Volt
-      setVoltage(DAC_NOTE1, 0, 1, int(filterCutoff * 1.9));
+      setVoltage(DAC_NOTE1, 0, 1, int(modApply(filterCutoff, MODDST_CUTOFF) * 1.9));
       setVoltage(DAC_NOTE1, 1, 1, int(filterRes * 1.9));
       break;
     case 9:  // 6 Volt
-      setVoltage(DAC_NOTE1, 0, 1, int((osc1PW * 1.22) + 50));
-      setVoltage(DAC_NOTE1, 1, 1, int((osc2PW * 1.22) + 50));
+      setVoltage(DAC_NOTE1, 0, 1, int((modApply(osc1PW, MODDST_OSC1PW) * 1.22) + 50));
+      setVoltage(DAC_NOTE1, 1, 1, int((modApply(osc2PW, MODDST_OSC2PW) * 1.22) + 50));
       break;
     case 10:  // 2 Volt
-      setVoltage(DAC_NOTE1, 0, 1, int(osc1level * 2));
-      setVoltage(DAC_NOTE1, 1, 1, int(osc2level * 2));
+      setVoltage(DAC_NOTE1, 0, 1, int(modApply(osc1level, MODDST_OSC1LEVEL) * 2));
+      setVoltage(DAC_NOTE1, 1, 1, int(modApply(osc2level, MODDST_OSC2LEVEL) * 2));
       break;
     case 11:
       // 0-2V
@@ -2904,23 +3483,28 @@ void writeDemux() {
       }
       setVoltage(DAC_NOTE1, 0, 1, offset);
       // 10 Volt
-      setVoltage(DAC_NOTE1, 1, 1, int(glide * 1.9));
+      setVoltage(DAC_NOTE1, 1, 1, int((seqSlideGlide ? max(glide, SEQ_SLIDE_GLIDE) : glide) * 1.9));
       break;
     case 12:
       // 0-5V
       setVoltage(DAC_NOTE1, 0, 1, int(filterLevel * 1.85));
-      setVoltage(DAC_NOTE1, 1, 1, int(volume * 2));
+      setVoltage(DAC_NOTE1, 1, 1, int(modApply(volume, MODDST_VOLUME) * 2));
       break;
     case 13:
       setVoltage(DAC_NOTE1, 0, 0, int(osc1foot));
       setVoltage(DAC_NOTE1, 1, 0, int(osc2foot));
       break;
-    case 14:
+    case 14:  // Spare - mod matrix LFO3 / LFO4
+      setVoltage(DAC_NOTE1, 0, 1, modSpareCode[0]);
+      setVoltage(DAC_NOTE1, 1, 1, modSpareCode[1]);
       break;
-    case 15:
+    case 15:  // Spare - mod matrix loop env / S&H
+      setVoltage(DAC_NOTE1, 0, 1, modSpareCode[2]);
+      setVoltage(DAC_NOTE1, 1, 1, modSpareCode[3]);
       break;
   }
   delayMicroseconds(DelayForSH3);
+  TRACE(TR_DEMUX, muxOutput, 0);
 
   muxOutput++;
   if (muxOutput >= DEMUXCHANNELS)
@@ -2936,238 +3520,6 @@ void showSettingsPage() {
   showSettingsPage(settings::current_setting(), settings::current_setting_value(), state);
 }
 
-void onButtonPress(uint16_t btnIndex, uint8_t btnType) {
-
-  if (btnIndex == OSC1_32 && btnType == ROX_PRESSED) {
-    osc1_32switch = !osc1_32switch;
-    myControlChange(midiChannel, CCosc1_32, osc1_32switch);
-  }
-
-  if (btnIndex == OSC1_16 && btnType == ROX_PRESSED) {
-    osc1_16switch = !osc1_16switch;
-    myControlChange(midiChannel, CCosc1_16, osc1_16switch);
-  }
-
-  if (btnIndex == OSC1_8 && btnType == ROX_PRESSED) {
-    osc1_8switch = !osc1_8switch;
-    myControlChange(midiChannel, CCosc1_8, osc1_8switch);
-  }
-
-  if (btnIndex == OSC1_SAW && btnType == ROX_PRESSED) {
-    osc1_sawswitch = !osc1_sawswitch;
-    myControlChange(midiChannel, CCosc1_saw, osc1_sawswitch);
-  }
-
-  if (btnIndex == OSC1_TRI && btnType == ROX_PRESSED) {
-    osc1_triswitch = !osc1_triswitch;
-    myControlChange(midiChannel, CCosc1_tri, osc1_triswitch);
-  }
-
-  if (btnIndex == OSC1_PULSE && btnType == ROX_PRESSED) {
-    osc1_pulseswitch = !osc1_pulseswitch;
-    myControlChange(midiChannel, CCosc1_pulse, osc1_pulseswitch);
-  }
-
-  if (btnIndex == SINGLE_TRIG && btnType == ROX_PRESSED) {
-    singleswitch = true;
-    multiswitch = false;
-    myControlChange(midiChannel, CCsingle, singleswitch);
-  }
-
-  if (btnIndex == MULTIPLE_TRIG && btnType == ROX_PRESSED) {
-    multiswitch = true;
-    singleswitch = false;
-    myControlChange(midiChannel, CCmulti, multiswitch);
-  }
-
-  if (btnIndex == LFO_TRIANGLE && btnType == ROX_PRESSED) {
-    lfoTriangleswitch = !lfoTriangleswitch;
-    myControlChange(midiChannel, CClfoTriangle, lfoTriangleswitch);
-  }
-
-  if (btnIndex == LFO_SQUARE && btnType == ROX_PRESSED) {
-    lfoSquareswitch = !lfoSquareswitch;
-    myControlChange(midiChannel, CClfoSquare, lfoSquareswitch);
-  }
-
-  if (btnIndex == SYNC_OFF && btnType == ROX_PRESSED) {
-    syncOffswitch = 1;
-    syncOnswitch = 0;
-    myControlChange(midiChannel, CCsyncOff, syncOffswitch);
-  }
-
-  if (btnIndex == SYNC_ON && btnType == ROX_PRESSED) {
-    syncOnswitch = 1;
-    syncOffswitch = 0;
-    myControlChange(midiChannel, CCsyncOn, syncOnswitch);
-  }
-
-  if (btnIndex == OCTAVE_0 && btnType == ROX_PRESSED) {
-    octave0switch = !octave0switch;
-    myControlChange(midiChannel, CCoctave0, octave0switch);
-  }
-
-  if (btnIndex == OCTAVE_1 && btnType == ROX_PRESSED) {
-    octave1switch = !octave1switch;
-    myControlChange(midiChannel, CCoctave1, octave1switch);
-  }
-
-  if (btnIndex == KB_OFF && btnType == ROX_PRESSED) {
-    kbOffswitch = !kbOffswitch;
-    myControlChange(midiChannel, CCkbOff, kbOffswitch);
-  }
-
-  if (btnIndex == KB_HALF && btnType == ROX_PRESSED) {
-    kbHalfswitch = !kbHalfswitch;
-    myControlChange(midiChannel, CCkbHalf, kbHalfswitch);
-  }
-
-  if (btnIndex == KB_FULL && btnType == ROX_PRESSED) {
-    kbFullswitch = !kbFullswitch;
-    myControlChange(midiChannel, CCkbFull, kbFullswitch);
-  }
-
-  if (btnIndex == OSC2_32 && btnType == ROX_PRESSED) {
-    osc2_32switch = !osc2_32switch;
-    myControlChange(midiChannel, CCosc2_32, osc2_32switch);
-  }
-
-  if (btnIndex == OSC2_16 && btnType == ROX_PRESSED) {
-    osc2_16switch = !osc2_16switch;
-    myControlChange(midiChannel, CCosc2_16, osc2_16switch);
-  }
-
-  if (btnIndex == OSC2_8 && btnType == ROX_PRESSED) {
-    osc2_8switch = !osc2_8switch;
-    myControlChange(midiChannel, CCosc2_8, osc2_8switch);
-  }
-
-  if (btnIndex == OSC2_SAW && btnType == ROX_PRESSED) {
-    osc2_sawswitch = !osc2_sawswitch;
-    myControlChange(midiChannel, CCosc2_saw, osc2_sawswitch);
-  }
-
-  if (btnIndex == OSC2_TRI && btnType == ROX_PRESSED) {
-    osc2_triswitch = !osc2_triswitch;
-    myControlChange(midiChannel, CCosc2_tri, osc2_triswitch);
-  }
-
-  if (btnIndex == OSC2_PULSE && btnType == ROX_PRESSED) {
-    osc2_pulseswitch = !osc2_pulseswitch;
-    myControlChange(midiChannel, CCosc2_pulse, osc2_pulseswitch);
-  }
-
-  if (btnIndex == LFO_OSC_OFF && btnType == ROX_PRESSED) {
-    lfoOscOnswitch = !lfoOscOnswitch;
-    myControlChange(midiChannel, CClfoOscOn, lfoOscOnswitch);
-  }
-
-  if (btnIndex == LFO_OSC_ON && btnType == ROX_PRESSED) {
-    lfoOscOnswitch = !lfoOscOnswitch;
-    myControlChange(midiChannel, CClfoOscOn, lfoOscOnswitch);
-  }
-
-  if (btnIndex == LFO_VCF_OFF && btnType == ROX_PRESSED) {
-    lfoVCFOnswitch = !lfoVCFOnswitch;
-    myControlChange(midiChannel, CClfoVCFOn, lfoVCFOnswitch);
-  }
-
-  if (btnIndex == LFO_VCF_ON && btnType == ROX_PRESSED) {
-    lfoVCFOnswitch = !lfoVCFOnswitch;
-    myControlChange(midiChannel, CClfoVCFOn, lfoVCFOnswitch);
-  }
-
-  if (btnIndex == LEVEL1 && btnType == ROX_PRESSED) {
-    level1switch = !level1switch;
-    myControlChange(midiChannel, CClevel1, level1switch);
-  }
-
-  if (btnIndex == LEVEL2 && btnType == ROX_PRESSED) {
-    level2switch = !level2switch;
-    myControlChange(midiChannel, CClevel2, level2switch);
-  }
-
-  if (btnIndex == BUTTON1 && btnType == ROX_PRESSED) {
-    button1switch = !button1switch;
-    myControlChange(midiChannel, CCbutton1, button1switch);
-  }
-
-  if (btnIndex == BUTTON2 && btnType == ROX_PRESSED) {
-    button2switch = !button2switch;
-    myControlChange(midiChannel, CCbutton2, button2switch);
-  }
-
-  if (btnIndex == BUTTON3 && btnType == ROX_PRESSED) {
-    button3switch = !button3switch;
-    myControlChange(midiChannel, CCbutton3, button3switch);
-  }
-
-  if (btnIndex == BUTTON4 && btnType == ROX_PRESSED) {
-    button4switch = !button4switch;
-    myControlChange(midiChannel, CCbutton4, button4switch);
-  }
-
-  if (btnIndex == BUTTON5 && btnType == ROX_PRESSED) {
-    button5switch = !button5switch;
-    myControlChange(midiChannel, CCbutton5, button5switch);
-  }
-
-  if (btnIndex == BUTTON6 && btnType == ROX_PRESSED) {
-    button6switch = !button6switch;
-    myControlChange(midiChannel, CCbutton6, button6switch);
-  }
-
-  if (btnIndex == BUTTON7 && btnType == ROX_PRESSED) {
-    button7switch = !button7switch;
-    myControlChange(midiChannel, CCbutton7, button7switch);
-  }
-
-  if (btnIndex == BUTTON8 && btnType == ROX_PRESSED) {
-    button8switch = !button8switch;
-    myControlChange(midiChannel, CCbutton8, button8switch);
-  }
-
-  if (btnIndex == BUTTON9 && btnType == ROX_PRESSED) {
-    button9switch = !button9switch;
-    myControlChange(midiChannel, CCbutton9, button9switch);
-  }
-
-  if (btnIndex == BUTTON10 && btnType == ROX_PRESSED) {
-    button10switch = !button10switch;
-    myControlChange(midiChannel, CCbutton10, button10switch);
-  }
-
-  if (btnIndex == BUTTON11 && btnType == ROX_PRESSED) {
-    button11switch = !button11switch;
-    myControlChange(midiChannel, CCbutton11, button11switch);
-  }
-
-  if (btnIndex == BUTTON12 && btnType == ROX_PRESSED) {
-    button12switch = !button12switch;
-    myControlChange(midiChannel, CCbutton12, button12switch);
-  }
-
-  if (btnIndex == BUTTON13 && btnType == ROX_PRESSED) {
-    button13switch = !button13switch;
-    myControlChange(midiChannel, CCbutton13, button13switch);
-  }
-
-  if (btnIndex == BUTTON14 && btnType == ROX_PRESSED) {
-    button14switch = !button14switch;
-    myControlChange(midiChannel, CCbutton14, button14switch);
-  }
-
-  if (btnIndex == BUTTON15 && btnType == ROX_PRESSED) {
-    button15switch = !button15switch;
-    myControlChange(midiChannel, CCbutton15, button15switch);
-  }
-
-  if (btnIndex == BUTTON16 && btnType == ROX_PRESSED) {
-    button16switch = !button16switch;
-    myControlChange(midiChannel, CCbutton16, button16switch);
-  }
-}
-
 void checkEEProm() {
 
   if (oldclocksource != clocksource) {
@@ -3183,6 +3535,7 @@ void checkEEProm() {
     }
     oldclocksource = clocksource;
   }
+  checkSettingsFlush();
 }
 
 void checkSwitches() {
@@ -3203,16 +3556,25 @@ void checkSwitches() {
         case PARAMETER:
           if (patches.size() < PATCHES_LIMIT) {
             resetPatchesOrdering();  //Reset order of patches from first patch
-            patches.push({ patches.size() + 1, INITPATCHNAME });
+            patches.push(patches.size() + 1, INITPATCHNAME);
             //patches.push({ patchNo, patchName });
             state = SAVE;
           }
           break;
+        case RECALL:
+          state = SEARCH;
+          charIndex = 0;
+          currentCharacter = CHARACTERS[charIndex];
+          break;
+        case SEARCH:
+          if (searchCount) state = RECALL;
+          break;
         case SAVE:
           //Save as new patch with INITIALPATCH name or overwrite existing keeping name - bypassing patch renaming
           patchName = patches.last().patchName;
           state = PATCH;
-          savePatch(String(patches.last().patchNo).c_str(), getCurrentPatchData());
+          savePatch(patches.last().patchNo, getCurrentPatchData());
+          patchSaved();
           showPatchPage(patches.last().patchNo, patches.last().patchName);
           patchNo = patches.last().patchNo;
           loadPatches();  //Get rid of pushed patch if it wasn't saved
@@ -3223,7 +3585,8 @@ void checkSwitches() {
         case PATCHNAMING:
           if (renamedPatch.length() > 0) patchName = renamedPatch;  //Prevent empty strings
           state = PATCH;
-          savePatch(String(patches.last().patchNo).c_str(), getCurrentPatchData());
+          savePatch(patches.last().patchNo, getCurrentPatchData());
+          patchSaved();
           showPatchPage(patches.last().patchNo, patchName);
           patchNo = patches.last().patchNo;
           loadPatches();  //Get rid of pushed patch if it wasn't saved
@@ -3266,12 +3629,22 @@ void checkSwitches() {
     backButton.write(HIGH);              //Come out of this state
     panic = true;                        //Hack
   } else if (backButton.risingEdge()) {  //cannot be fallingEdge because holding button won't work
-    if (!panic) {
+    if (midiLearnCancel()) {
+      panic = false;
+    } else if (!panic) {
       switch (state) {
         case RECALL:
+          searchEnd();
           setPatchesOrdering(patchNo);
           state = PARAMETER;
           break;
+        case SEARCH:
+          if (!searchDeleteChar()) {
+            searchEnd();
+            setPatchesOrdering(patchNo);
+            state = RECALL;
+          }
+          break;
         case SAVE:
           renamedPatch = "";
           state = PARAMETER;
@@ -3316,6 +3689,7 @@ void checkSwitches() {
     if (!recall) {
       switch (state) {
         case PARAMETER:
+          searchEnd();
           state = RECALL;  //show patch list
           break;
         case RECALL:
@@ -3330,6 +3704,11 @@ void checkSwitches() {
           patchName = patches.last().patchName;
           state = PATCHNAMING;
           break;
+        case SEARCH:
+          searchAddChar(currentCharacter);
+          charIndex = 0;
+          currentCharacter = CHARACTERS[charIndex];
+          break;
         case PATCHNAMING:
           if (renamedPatch.length() < 13) {
             renamedPatch.concat(String(currentCharacter));
@@ -3343,11 +3722,11 @@ void checkSwitches() {
           if (patches.size() > 1) {
             state = DELETEMSG;
             patchNo = patches.first().patchNo;     //PatchNo to delete from SD card
-            patches.shift();                       //Remove patch from circular buffer
-            deletePatch(String(patchNo).c_str());  //Delete from SD card
-            loadPatches();                         //Repopulate circular buffer to start from lowest Patch No
+            patches.removeFirst();                 //Remove patch from the list
+            deletePatch(patchNo);                  //Delete from SD card
+            loadPatches();                         //Repopulate the list to start from lowest Patch No
             renumberPatchesOnSD();
-            loadPatches();                      //Repopulate circular buffer again after delete
+            loadPatches();                      //Repopulate the list again after delete
             patchNo = patches.first().patchNo;  //Go back to 1
             recallPatch(patchNo);               //Load first patch
           }
@@ -3390,17 +3769,17 @@ void checkEncoder() {
   if ((encCW && encRead > encPrevious + 3) || (!encCW && encRead < encPrevious - 3)) {
     switch (state) {
       case PARAMETER:
-        state = PATCH;
-        patches.push(patches.shift());
-        patchNo = patches.first().patchNo;
-        recallPatch(patchNo);
-        state = PARAMETER;
+        browsePatches(true);
         break;
       case RECALL:
-        patches.push(patches.shift());
+        searchActive ? searchStep(true) : patches.next();
+        break;
+      case SEARCH:
+        if (charIndex == TOTALCHARS) charIndex = 0;  //Wrap around
+        currentCharacter = CHARACTERS[charIndex++];
         break;
       case SAVE:
-        patches.push(patches.shift());
+        patches.next();
         break;
       case PATCHNAMING:
         if (charIndex == TOTALCHARS) charIndex = 0;  //Wrap around
@@ -3408,7 +3787,7 @@ void checkEncoder() {
         showRenamingPage(renamedPatch + currentCharacter);
         break;
       case DELETE:
-        patches.push(patches.shift());
+        patches.next();
         break;
       case SETTINGS:
         settings::increment_setting();
@@ -3423,17 +3802,18 @@ void checkEncoder() {
   } else if ((encCW && encRead < encPrevious - 3) || (!encCW && encRead > encPrevious + 3)) {
     switch (state) {
       case PARAMETER:
-        state = PATCH;
-        patches.unshift(patches.pop());
-        patchNo = patches.first().patchNo;
-        recallPatch(patchNo);
-        state = PARAMETER;
+        browsePatches(false);
         break;
       case RECALL:
-        patches.unshift(patches.pop());
+        searchActive ? searchStep(false) : patches.prev();
+        break;
+      case SEARCH:
+        if (charIndex == -1)
+          charIndex = TOTALCHARS - 1;
+        currentCharacter = CHARACTERS[charIndex--];
         break;
       case SAVE:
-        patches.unshift(patches.pop());
+        patches.prev();
         break;
       case PATCHNAMING:
         if (charIndex == -1)
@@ -3442,7 +3822,7 @@ void checkEncoder() {
         showRenamingPage(renamedPatch + currentCharacter);
         break;
       case DELETE:
-        patches.unshift(patches.pop());
+        patches.prev();
         break;
       case SETTINGS:
         settings::decrement_setting();
@@ -3458,26 +3838,50 @@ void checkEncoder() {
 }
 
 void loop() {
-  myusb.Task();
-  midi1.read(midiChannel);  //USB HOST MIDI Class Compliant
+  loopBudgetBegin();
+  if (usbHostStarted) {
+    myusb.Task();
+    TRACE_PORT(TR_PORT_HOST);
+    midi1.read(midiChannel);  //USB HOST MIDI Class Compliant
+  } else if (millis() - bootMillis >= USB_HOST_START_MS) {
+    startUsbHost();
+  }
+  TRACE_PORT(TR_PORT_DIN);
   MIDI.read(midiChannel);
+  TRACE_PORT(TR_PORT_USB);
   usbMIDI.read(midiChannel);
-  checkMux();
+  if (!shedPots()) checkMux();
+  checkPatchTx();
   writeDemux();
   boardswitch.update();
-  mux.update();
-  checkSwitches();
-  checkEncoder();
+  checkPanelSwitches();
+  //Patch buttons and browsing wait for the patch list
+  if (patchIndexReady) {
+    checkSwitches();
+    checkEncoder();
+    checkBrowse();
+  } else if (patchIndexStep()) {
+    patchIndexDone();
+  }
   stopClockPulse();
   stopTriggerPulse();
   checkEEProm();
+  extClockReport();
+  checkTrace();
+  checkSysex();
+  checkMidiOut();
+  checkMidiLearn();
+  checkAutosave();
+  if (!bootReported && usbHostStarted && patchIndexReady) bootReport();
 
   // Timing engines last; only one should own the gate at a time
-  if (seqEnabled) {
-    seqEngine();
-  } else if (arpEnabled) {
+  // The sequencer runs from its own timers, the external clock steps both from its interrupt
+  if (arpEnabled && !seqEnabled && seqClockSource == SEQ_CLOCK_INTERNAL) {
     arpEngine();
   }
+
+  if (!shedLeds()) flushLeds();
+  loopBudgetEnd();
 }
 
 
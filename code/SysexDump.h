@@ -0,0 +1,433 @@
+// SysEx patch dump and restore
+//
+// Patches go to and from the SD card one file at a time, in chunks of
+// SYSEX_CHUNK bytes, so a whole bank never sits in RAM. Every chunk waits for
+// an ACK before the next one goes, which paces the transfer to the slower
+// end. loop() moves at most one chunk per pass, everything else, notes
+// included, carries on while a transfer runs.
+//
+// Works over USB, DIN and USB host MIDI, replies go back to the port the
+// request came in on. All messages are
+//
+//   F0 7D 53 cmd ... F7
+//
+// 14 bit numbers are sent as two 7 bit bytes, high first.
+//
+//   01 nn nn                 request patch nn
+//   02                       request all patches
+//   10 nn nn cc cc f data    chunk cc of patch nn, f bit 0 = last chunk
+//   11 nn nn cc cc           ACK of that chunk
+//   12 nn nn r               NAK, r = SysexNak reason
+//   13 nn nn                 end of a bank dump, nn patches
+//
+// data is the file packed 7 to 8: a byte holding bit 7 of the next 7 bytes
+// (first byte in bit 0) followed by those bytes with bit 7 cleared.
+//
+// The synth sends 10 and 13 in reply to 01 / 02 and waits for 11 after each
+// chunk. To load, the host sends 10 and waits for 11; 13 is optional. A
+// received patch replaces the file with the same number once its last chunk
+// is in, and the patch list is rebuilt when the host goes quiet.
+//
+// Sequences a patch file keeps in the sequence library (SeqLibrary.h) are
+// written back into a copy of the file in full before it is sent, so a dump
+// restores on a card with a different library.
+//
+// tools/sysex_patches.py is a host side for backing up and restoring.
+
+#define SYSEX_ID 0x7D  // Non-commercial
+#define SYSEX_MODEL 'S'
+#define SYSEX_CHUNK 96  // Keeps a DIN message inside the MIDI library's 128 byte limit
+#define SYSEX_PACKED_MAX ((SYSEX_CHUNK + 6) / 7 * 8)
+#define SYSEX_MSG_MAX (4 + 5 + SYSEX_PACKED_MAX + 1)
+#define SYSEX_ACK_TIMEOUT_MS 1000
+#define SYSEX_RETRIES 3
+#define SYSEX_RX_IDLE_MS 1000  // Receive is over after this long without a chunk
+#define SYSEX_TMP "/SYSEX/RX.TMP"  // In a directory so the patch list skips it
+#define SYSEX_TX_TMP "/SYSEX/TX.TMP"
+
+enum SysexCmd : uint8_t {
+  SX_REQ_PATCH = 0x01,
+  SX_REQ_BANK = 0x02,
+  SX_DATA = 0x10,
+  SX_ACK = 0x11,
+  SX_NAK = 0x12,
+  SX_BANK_END = 0x13
+};
+
+enum SysexNak : uint8_t {
+  SX_NAK_BUSY = 1,
+  SX_NAK_NO_PATCH = 2,
+  SX_NAK_ORDER = 3,
+  SX_NAK_SD = 4,
+  SX_NAK_TIMEOUT = 5
+};
+
+enum SysexPort : uint8_t {
+  SX_DIN,
+  SX_USB,
+  SX_HOST
+};
+
+enum SysexState : uint8_t {
+  SX_IDLE,
+  SX_SEND,      // Next chunk goes when the port has room
+  SX_WAIT_ACK,
+  SX_RECEIVE
+};
+
+SysexState sxState = SX_IDLE;
+SysexPort sxPort = SX_USB;
+File sxFile;
+int sxBankPos = -1;  // Position in the patch list during a bank dump, -1 for one patch
+uint16_t sxBankSent = 0;
+uint16_t sxPatchNo = 0;
+uint16_t sxChunk = 0;
+uint8_t sxRetries = 0;
+boolean sxLast = false;
+elapsedMillis sxTimer;
+
+// A received chunk waits here for loop() to write it, the sender holds the
+// next one back until it is ACKed
+uint8_t sxRxData[SYSEX_CHUNK];
+uint8_t sxRxLen = 0;
+uint16_t sxRxPatchNo = 0;
+uint16_t sxRxChunk = 0;
+boolean sxRxLast = false;
+boolean sxRxPending = false;
+uint16_t sxReceived = 0;
+
+uint8_t sxDinTxMemory[SYSEX_MSG_MAX];
+
+// Defined in Source.ino
+String seqToCsv(const StepSeq &s);
+void clearSeq(StepSeq &s);
+
+size_t sysexPack(const uint8_t *in, size_t len, uint8_t *out) {
+  size_t n = 0;
+  for (size_t i = 0; i < len; i += 7) {
+    size_t msbs = n++;
+    out[msbs] = 0;
+    for (size_t j = 0; j < 7 && i + j < len; j++) {
+      if (in[i + j] & 0x80) out[msbs] |= 1 << j;
+      out[n++] = in[i + j] & 0x7F;
+    }
+  }
+  return n;
+}
+
+size_t sysexUnpack(const uint8_t *in, size_t len, uint8_t *out, size_t max) {
+  size_t n = 0;
+  for (size_t i = 0; i < len; i += 8) {
+    for (size_t j = 1; j < 8 && i + j < len && n < max; j++) {
+      out[n++] = in[i + j] | (((in[i] >> (j - 1)) & 1) << 7);
+    }
+  }
+  return n;
+}
+
+boolean sysexPortReady() {
+  return sxPort != SX_DIN || Serial1.availableForWrite() >= SYSEX_MSG_MAX;
+}
+
+void sysexSend(const uint8_t *msg, size_t len) {
+  switch (sxPort) {
+    case SX_DIN:
+      MIDI.sendSysEx(len, msg, true);
+      break;
+    case SX_USB:
+      usbMIDI.sendSysEx(len, msg, true);
+      usbMIDI.send_now();
+      break;
+    case SX_HOST:
+      midi1.sendSysEx(len, msg, true);
+      midi1.send_now();
+      break;
+  }
+}
+
+size_t sysexHeader(uint8_t *msg, SysexCmd cmd, uint16_t value) {
+  msg[0] = 0xF0;
+  msg[1] = SYSEX_ID;
+  msg[2] = SYSEX_MODEL;
+  msg[3] = cmd;
+  msg[4] = (value >> 7) & 0x7F;
+  msg[5] = value & 0x7F;
+  return 6;
+}
+
+void sysexReply(SysexCmd cmd, uint16_t value, int extra = -1) {
+  uint8_t msg[12];
+  size_t len = sysexHeader(msg, cmd, value);
+  if (cmd == SX_ACK) {
+    msg[len++] = (sxChunk >> 7) & 0x7F;
+    msg[len++] = sxChunk & 0x7F;
+  }
+  if (extra >= 0) msg[len++] = extra;
+  msg[len++] = 0xF7;
+  sysexSend(msg, len);
+}
+
+void sysexAbort(SysexNak reason) {
+  if (sxFile) sxFile.close();
+  if (sxState == SX_RECEIVE) SD.remove(SYSEX_TMP);
+  sysexReply(SX_NAK, sxPatchNo, reason);
+  Serial.println("SysEx transfer stopped:" + String((int)reason));
+  sxState = SX_IDLE;
+  sxRxPending = false;
+}
+
+// Copies the patch to SYSEX_TX_TMP with library references replaced by
+// the sequences they stand for
+boolean sysexExpandPatch(uint16_t number) {
+  File patchFile = SD.open(patchPath(number).c_str());
+  if (!patchFile) return false;
+  SD.mkdir("/SYSEX");
+  SD.remove(SYSEX_TX_TMP);
+  File out = SD.open(SYSEX_TX_TMP, FILE_WRITE);
+  if (!out) {
+    patchFile.close();
+    return false;
+  }
+
+  PatchReader reader(patchFile);
+  boolean name = true;  // A name may start with the tag
+  while (reader.more()) {
+    if (!name) out.write(',');
+    if (!name && reader.peek() == SEQ_LIBRARY_TAG) {
+      StepSeq s;
+      reader.fieldChar();
+      if (!seqLibGet(reader.readInt(), s)) clearSeq(s);
+      out.print(seqToCsv(s));
+    } else {
+      int c;
+      while ((c = reader.fieldChar()) >= 0) out.write((uint8_t)c);
+    }
+    name = false;
+  }
+  out.println();
+  out.close();
+  patchFile.close();
+  return true;
+}
+
+boolean sysexOpenPatch(uint16_t number) {
+  sxPatchNo = number;
+  sxChunk = 0;
+  sxRetries = 0;
+  if (!sysexExpandPatch(number)) return false;
+  sxFile = SD.open(SYSEX_TX_TMP);
+  if (!sxFile) return false;
+  sxState = SX_SEND;
+  return true;
+}
+
+void sysexSendChunk() {
+  uint8_t raw[SYSEX_CHUNK];
+  int n = sxFile.read(raw, sizeof(raw));
+  if (n < 0) n = 0;
+  sxLast = !sxFile.available();
+
+  uint8_t msg[SYSEX_MSG_MAX];
+  size_t len = sysexHeader(msg, SX_DATA, sxPatchNo);
+  msg[len++] = (sxChunk >> 7) & 0x7F;
+  msg[len++] = sxChunk & 0x7F;
+  msg[len++] = sxLast ? 1 : 0;
+  len += sysexPack(raw, n, &msg[len]);
+  msg[len++] = 0xF7;
+  sysexSend(msg, len);
+  sxState = SX_WAIT_ACK;
+  sxTimer = 0;
+}
+
+void sysexBankEnd() {
+  sysexReply(SX_BANK_END, sxBankSent);
+  Serial.println("SysEx dump sent " + String(sxBankSent) + " patches");
+  sxState = SX_IDLE;
+}
+
+void sysexAcked() {
+  sxRetries = 0;
+  if (!sxLast) {
+    sxChunk++;
+    sxState = SX_SEND;
+    return;
+  }
+  sxFile.close();
+  sxState = SX_IDLE;
+  if (sxBankPos < 0) return;
+  sxBankSent++;
+  // A patch that has gone since the list was read is skipped
+  while (++sxBankPos < patches.size()) {
+    if (sysexOpenPatch(patches.inOrder(sxBankPos).patchNo)) return;
+  }
+  sysexBankEnd();
+}
+
+void sysexWriteChunk() {
+  sxRxPending = false;
+  if (sxRxChunk == 0) {
+    if (sxFile) sxFile.close();
+    SD.mkdir("/SYSEX");
+    SD.remove(SYSEX_TMP);
+    sxFile = SD.open(SYSEX_TMP, FILE_WRITE);
+    sxPatchNo = sxRxPatchNo;
+    sxChunk = 0;
+    if (!sxFile) {
+      sysexAbort(SX_NAK_SD);
+      return;
+    }
+  } else if (sxRxPatchNo == sxPatchNo && sxRxChunk == sxChunk) {
+    sysexReply(SX_ACK, sxPatchNo);  // Our ACK was lost, the chunk is already written
+    sxTimer = 0;
+    return;
+  } else if (!sxFile || sxRxPatchNo != sxPatchNo || sxRxChunk != sxChunk + 1) {
+    sysexAbort(SX_NAK_ORDER);
+    return;
+  } else {
+    sxChunk = sxRxChunk;
+  }
+
+  if (sxFile.write(sxRxData, sxRxLen) != sxRxLen) {
+    sysexAbort(SX_NAK_SD);
+    return;
+  }
+  if (sxRxLast) {
+    sxFile.close();
+    String name = patchPath(sxPatchNo);
+    SD.remove(name.c_str());
+    if (!SD.rename(SYSEX_TMP, name.c_str())) {
+      sysexAbort(SX_NAK_SD);
+      return;
+    }
+    sxReceived++;
+  }
+  sysexReply(SX_ACK, sxPatchNo);
+  sxTimer = 0;
+}
+
+void sysexReceiveDone() {
+  if (sxFile) {
+    sxFile.close();
+    SD.remove(SYSEX_TMP);
+  }
+  sxState = SX_IDLE;
+  Serial.println("SysEx received " + String(sxReceived) + " patches");
+  if (sxReceived) startPatchIndex();  // Rebuilt from loop(), patchIndexDone() keeps the current patch
+  sxReceived = 0;
+}
+
+void sysexMessage(SysexPort port, const uint8_t *msg, unsigned len) {
+  if (len < 5 || msg[0] != 0xF0 || msg[1] != SYSEX_ID || msg[2] != SYSEX_MODEL || msg[len - 1] != 0xF7) return;
+  uint8_t cmd = msg[3];
+  const uint8_t *body = &msg[4];
+  unsigned bodyLen = len - 5;
+  uint16_t number = bodyLen >= 2 ? (body[0] << 7) | body[1] : 0;
+  uint16_t chunk = bodyLen >= 4 ? (body[2] << 7) | body[3] : 0;
+
+  if (sxState != SX_IDLE && port != sxPort) {
+    SysexPort busyPort = sxPort;
+    sxPort = port;
+    sysexReply(SX_NAK, number, SX_NAK_BUSY);
+    sxPort = busyPort;
+    return;
+  }
+
+  switch (cmd) {
+    case SX_REQ_PATCH:
+    case SX_REQ_BANK:
+      sxPort = port;
+      if (sxState != SX_IDLE || !patchIndexReady) {
+        sysexReply(SX_NAK, number, SX_NAK_BUSY);
+      } else if (cmd == SX_REQ_PATCH) {
+        sxBankPos = -1;
+        if (!sysexOpenPatch(number)) sysexReply(SX_NAK, number, SX_NAK_NO_PATCH);
+      } else {
+        sxBankPos = -1;
+        sxBankSent = 0;
+        while (++sxBankPos < patches.size()) {
+          if (sysexOpenPatch(patches.inOrder(sxBankPos).patchNo)) break;
+        }
+        if (sxState == SX_IDLE) sysexBankEnd();
+      }
+      break;
+
+    case SX_ACK:
+      if (sxState == SX_WAIT_ACK && number == sxPatchNo && chunk == sxChunk) sysexAcked();
+      break;
+
+    case SX_NAK:
+      if (sxState == SX_SEND || sxState == SX_WAIT_ACK) {
+        sxFile.close();
+        sxState = SX_IDLE;
+      }
+      break;
+
+    case SX_DATA:
+      if (bodyLen < 5) return;
+      sxPort = port;
+      if (sxState == SX_SEND || sxState == SX_WAIT_ACK || sxRxPending) {
+        sysexReply(SX_NAK, number, SX_NAK_BUSY);
+        return;
+      }
+      if (number < 1 || number > PATCHES_LIMIT) {
+        sysexReply(SX_NAK, number, SX_NAK_NO_PATCH);  // Before anything is written
+        return;
+      }
+      sxRxPatchNo = number;
+      sxRxChunk = chunk;
+      sxRxLast = body[4] & 1;
+      sxRxLen = sysexUnpack(&body[5], bodyLen - 5, sxRxData, sizeof(sxRxData));
+      sxRxPending = true;
+      sxState = SX_RECEIVE;
+      break;
+
+    case SX_BANK_END:
+      if (sxState == SX_RECEIVE && !sxRxPending) sysexReceiveDone();
+      break;
+  }
+}
+
+void sysexDin(byte *msg, unsigned len) {
+  sysexMessage(SX_DIN, msg, len);
+}
+
+// Messages longer than the USB sysex buffer arrive in parts, none of ours
+// are, so parts are ignored
+void sysexUsb(const uint8_t *msg, uint16_t len, bool complete) {
+  if (complete) sysexMessage(SX_USB, msg, len);
+}
+
+void sysexHost(const uint8_t *msg, uint16_t len, bool complete) {
+  if (complete) sysexMessage(SX_HOST, msg, len);
+}
+
+void sysexSetup() {
+  Serial1.addMemoryForWrite(sxDinTxMemory, sizeof(sxDinTxMemory));
+  MIDI.setHandleSystemExclusive(sysexDin);
+  usbMIDI.setHandleSystemExclusive(sysexUsb);
+  midi1.setHandleSystemExclusive(sysexHost);
+}
+
+// From loop(), one chunk at most per pass
+void checkSysex() {
+  switch (sxState) {
+    case SX_IDLE:
+      break;
+    case SX_SEND:
+      if (sysexPortReady()) sysexSendChunk();
+      break;
+    case SX_WAIT_ACK:
+      if (sxTimer < SYSEX_ACK_TIMEOUT_MS) break;
+      if (++sxRetries > SYSEX_RETRIES) {
+        sysexAbort(SX_NAK_TIMEOUT);
+      } else {
+        sxFile.seek((uint32_t)sxChunk * SYSEX_CHUNK);
+        sxState = SX_SEND;
+      }
+      break;
+    case SX_RECEIVE:
+      if (sxRxPending) sysexWriteChunk();
+      else if (sxTimer >= SYSEX_RX_IDLE_MS) sysexReceiveDone();
+      break;
+  }
+}
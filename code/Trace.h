@@ -0,0 +1,125 @@
+// Event trace
+//
+// Fixed ring buffer of cycle counter timestamped events, from MIDI arriving
+// to the gate and CVs changing. Any ISR or loop() can add an event: the slot
+// is claimed with an atomic increment and nothing allocates or locks. Once
+// full the oldest events are overwritten.
+//
+// Everything compiles out unless TRACE_ENABLED is defined, apart from
+// writeGate() / writeTrig() which are then plain pin writes.
+//
+// Sending 'T' over USB serial dumps the buffer, little endian:
+//
+//   "TRC1"            magic
+//   uint32            F_CPU, cycles per second
+//   uint32            event count n
+//   n x 8 bytes       uint32 cycles, uint8 event, uint8 arg, uint16 value
+//
+// Events are oldest first. The cycle counter wraps every ~24s at 180MHz so
+// latencies are differences between neighbouring events, taken mod 2^32.
+// Pairs worth measuring: TR_MIDI_IN -> TR_NOTE_ON -> TR_NOTE_DAC -> TR_GATE
+// and TR_PATCH_START -> TR_PATCH_END. tools/trace_analyze.py reads the dump
+// and prints these.
+//
+// TR_MIDI_IN is logged by the note and CC handlers as the MIDI library hands
+// them a message, with the port loop() was reading set by TRACE_PORT().
+
+//#define TRACE_ENABLED
+
+enum TraceEvent : uint8_t {
+  TR_MIDI_IN,      // arg TracePort, value status << 8 | first data byte
+  TR_NOTE_ON,      // arg note, value velocity
+  TR_NOTE_DAC,     // arg note, value CV code
+  TR_GATE,         // arg level
+  TR_TRIG,         // arg level
+  TR_DEMUX,        // arg channel
+  TR_PATCH_START,  // value patch number
+  TR_PATCH_END     // value patch number
+};
+
+enum TracePort : uint8_t {
+  TR_PORT_DIN,
+  TR_PORT_USB,
+  TR_PORT_HOST
+};
+
+#ifdef TRACE_ENABLED
+
+#define TRACE_SIZE 1024  // Power of two, 8KB
+
+struct TraceRecord {
+  uint32_t cycles;
+  uint8_t event;
+  uint8_t arg;
+  uint16_t value;
+};
+static_assert(sizeof(TraceRecord) == 8, "TraceRecord is dumped as 8 bytes");
+
+TraceRecord traceBuffer[TRACE_SIZE];
+volatile uint32_t traceHead = 0;
+volatile boolean tracePaused = false;
+uint8_t tracePort = TR_PORT_DIN;  // Port loop() is reading
+
+inline void traceEvent(uint8_t event, uint8_t arg, uint16_t value) {
+  if (tracePaused) return;
+  uint32_t cycles = ARM_DWT_CYCCNT;
+  uint32_t slot = __atomic_fetch_add(&traceHead, 1, __ATOMIC_RELAXED) & (TRACE_SIZE - 1);
+  TraceRecord &r = traceBuffer[slot];
+  r.cycles = cycles;
+  r.event = event;
+  r.arg = arg;
+  r.value = value;
+}
+
+void traceDump() {
+  tracePaused = true;
+  uint32_t head = traceHead;
+  uint32_t count = head < TRACE_SIZE ? head : TRACE_SIZE;
+  uint32_t cpu = F_CPU;
+  Serial.write((const uint8_t *)"TRC1", 4);
+  Serial.write((const uint8_t *)&cpu, 4);
+  Serial.write((const uint8_t *)&count, 4);
+  for (uint32_t i = head - count; i != head; i++) {
+    Serial.write((const uint8_t *)&traceBuffer[i & (TRACE_SIZE - 1)], sizeof(TraceRecord));
+  }
+  Serial.flush();
+  traceHead = 0;
+  tracePaused = false;
+}
+
+void checkTrace() {
+  while (Serial.available()) {
+    if (Serial.read() == 'T') traceDump();
+  }
+}
+
+#define TRACE(event, arg, value) traceEvent((event), (arg), (value))
+#define TRACE_PORT(port) (tracePort = (port))
+#define TRACE_MIDI_IN(status, data) traceEvent(TR_MIDI_IN, tracePort, ((status) << 8) | (data))
+
+#else
+
+#define TRACE(event, arg, value) \
+  do { \
+  } while (0)
+#define TRACE_PORT(port) \
+  do { \
+  } while (0)
+#define TRACE_MIDI_IN(status, data) \
+  do { \
+  } while (0)
+
+inline void checkTrace() {}
+
+#endif
+
+// Gate and trigger outputs go through these so their edges are traced
+inline void writeGate(uint8_t level) {
+  digitalWriteFast(GATE_NOTE1, level);
+  TRACE(TR_GATE, level, 0);
+}
+
+inline void writeTrig(uint8_t level) {
+  digitalWriteFast(TRIG_NOTE1, level);
+  TRACE(TR_TRIG, level, 0);
+}
@@ -0,0 +1,306 @@
+// Host fuzz and timing harness for PatchReader (code/PatchReader.h)
+//
+//   g++ -std=c++11 -O2 -g -fsanitize=address,undefined -I../code -o patchreader_test patchreader_test.cpp
+//   ./patchreader_test fuzz [ITERATIONS] [SEED]
+//   ./patchreader_test bench [PATCHES]
+//   ./patchreader_test FILE...      parse patch files copied off the SD card
+//
+// fuzz mutates a patch line the way the firmware writes it (bytes flipped,
+// dropped, repeated, delimiters and long digit runs put in) and checks that
+// every field ends, text stays inside its buffer and numbers stay inside
+// PATCH_INT_MAX. Before mutating, each line is parsed as written and must
+// give back the fields and sequence lengths it was built from. Lines are
+// both "v2" with compact sequences and the unversioned version 1 layout
+// older cards hold: 65 numbers then two sequences as a length and 64 steps.
+// bench times whole patch lines, the same fields in the same order as
+// setCurrentPatchData().
+//
+// With clang, -DPATCHREADER_LIBFUZZER -fsanitize=fuzzer builds a libFuzzer
+// target instead.
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <random>
+#include <string>
+#include <vector>
+
+// Just what PatchReader needs from the SD library
+class File
+{
+public:
+  File(const uint8_t *data, size_t size) : data(data), size(size) {}
+
+  int read(void *buf, size_t n)
+  {
+    if (pos >= size) return 0;
+    if (n > size - pos) n = size - pos;
+    memcpy(buf, data + pos, n);
+    pos += n;
+    return (int)n;
+  }
+
+private:
+  const uint8_t *data;
+  size_t size;
+  size_t pos = 0;
+};
+
+#include "PatchReader.h"
+
+constexpr int POT_MAX = 1023;  // As Parameters.h, for the limits in the schema
+#include "PatchFields.h"
+
+// The since column of the schema, readPatchFields() skips fields newer than the file
+#define PATCH_SINCE(type, name, lo, hi, def, since) since,
+static const int PATCH_FIELD_SINCE[] = { PATCH_FIELDS(PATCH_SINCE) };
+#undef PATCH_SINCE
+#define PATCH_INTS ((int)(sizeof(PATCH_FIELD_SINCE) / sizeof(PATCH_FIELD_SINCE[0])))
+
+#define PATCH_NAME_SIZE 32
+#define V1_FIELDS 65  // Numbers getCurrentPatchData() wrote before the version field, through afterTouchDepth
+#define SEQ_STEPS 64
+#define SEQ_COMPACT (-1)  // seqLength of a compact or library sequence
+
+// What a parse found, to check against what samplePatch() wrote
+struct Parsed
+{
+  int version = 1;
+  int fields[sizeof(PATCH_FIELD_SINCE) / sizeof(PATCH_FIELD_SINCE[0])] = {};
+  int seqLength[2] = {0, 0};
+};
+
+static void fail(const char *what)
+{
+  fprintf(stderr, "patchreader: %s\n", what);
+  abort();
+}
+
+// Name, version, the schema fields, the two sequences and whatever follows
+// as text, as a patch load reads it. Returns a checksum so the optimiser
+// keeps the work.
+static long parsePatch(const uint8_t *data, size_t size, Parsed *out = nullptr)
+{
+  Parsed parsed;
+  File file(data, size);
+  PatchReader reader(file);
+  long sum = 0;
+  size_t fields = 0;
+
+  char name[PATCH_NAME_SIZE];
+  size_t n = reader.readText(name, sizeof(name));
+  if (n >= sizeof(name) || name[n] != 0) fail("name not terminated in its buffer");
+  sum += n;
+
+  if (reader.peek() == 'v')
+  {
+    reader.fieldChar();
+    parsed.version = reader.readInt();
+    sum += parsed.version;
+  }
+
+  for (int i = 0; i < PATCH_INTS && reader.more(); i++)
+  {
+    if (PATCH_FIELD_SINCE[i] > parsed.version) continue;  // Default, as readPatchFields()
+    int value = reader.readInt();
+    if (value > PATCH_INT_MAX || value < -PATCH_INT_MAX) fail("number past PATCH_INT_MAX");
+    parsed.fields[i] = value;
+    sum += value;
+    if (++fields > size + 1) fail("field did not end");
+  }
+
+  // As readSeq(): a tagged field, or the old length and 64 steps
+  char text[16];
+  for (int s = 0; s < 2 && reader.more(); s++)
+  {
+    int c = reader.peek();
+    if (c == 'q' || c == 'L')
+    {
+      n = reader.readText(text, sizeof(text));
+      if (n >= sizeof(text) || text[n] != 0) fail("text not terminated in its buffer");
+      parsed.seqLength[s] = SEQ_COMPACT;
+      sum += n;
+      continue;
+    }
+    parsed.seqLength[s] = reader.readInt();
+    sum += parsed.seqLength[s];
+    for (int i = 0; i < SEQ_STEPS && reader.more(); i++)
+    {
+      sum += reader.readInt();
+      if (++fields > size + 1) fail("field did not end");
+    }
+  }
+
+  while (reader.more())
+  {
+    n = reader.readText(text, sizeof(text));
+    if (n >= sizeof(text) || text[n] != 0) fail("text not terminated in its buffer");
+    sum += n;
+    if (++fields > size + 1) fail("field did not end");
+  }
+  if (out) *out = parsed;
+  return sum;
+}
+
+// A version 2 patch with two compact sequences, or a version 1 patch as
+// the firmware wrote them before the version field
+static std::string samplePatch(std::mt19937 &rng, int version, Parsed &expect)
+{
+  std::string line = "Fat Bass";
+  expect = Parsed();
+  expect.version = version;
+  if (version > 1) line += ",v" + std::to_string(version);
+  for (int i = 0; i < (version > 1 ? PATCH_INTS : V1_FIELDS); i++)
+  {
+    expect.fields[i] = rng() % 1024;
+    line += ',';
+    line += std::to_string(expect.fields[i]);
+  }
+  static const char BASE64[] = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+  for (int s = 0; s < 2; s++)
+  {
+    if (version > 1)
+    {
+      expect.seqLength[s] = SEQ_COMPACT;
+      line += ",q";
+      for (int i = 0; i < 180; i++) line += BASE64[rng() % 64];
+      continue;
+    }
+    expect.seqLength[s] = rng() % (SEQ_STEPS + 1);
+    line += ',' + std::to_string(expect.seqLength[s]);
+    for (int i = 0; i < SEQ_STEPS; i++)
+    {
+      line += ',';
+      line += std::to_string(i < expect.seqLength[s] && rng() % 4 ? 36 + rng() % 48 : 255);  // 255 rest
+    }
+  }
+  line += "\r\n";
+  return line;
+}
+
+static void check(const Parsed &got, const Parsed &expect)
+{
+  if (got.version != expect.version) fail("version read back wrong");
+  if (memcmp(got.fields, expect.fields, sizeof(got.fields)) != 0) fail("fields read back wrong");
+  if (got.seqLength[0] != expect.seqLength[0] || got.seqLength[1] != expect.seqLength[1])
+  {
+    fail("sequences out of place");
+  }
+}
+
+static void mutate(std::string &line, std::mt19937 &rng)
+{
+  static const char SPECIAL[] = ",\r\n-+vqL0123456789";
+  int edits = 1 + rng() % 8;
+  for (int e = 0; e < edits && !line.empty(); e++)
+  {
+    size_t at = rng() % line.size();
+    switch (rng() % 6)
+    {
+      case 0:
+        line[at] = (char)(rng() & 0xFF);
+        break;
+      case 1:
+        line.erase(at, 1 + rng() % 16);
+        break;
+      case 2:
+        line.insert(at, 1, SPECIAL[rng() % (sizeof(SPECIAL) - 1)]);
+        break;
+      case 3:
+        line.insert(at, std::string(1 + rng() % 40, (char)('0' + rng() % 10)));
+        break;
+      case 4:
+        line.insert(at, line.substr(at, rng() % 700));  // Across the block boundary
+        break;
+      case 5:
+        line.resize(at);
+        break;
+    }
+  }
+}
+
+#ifdef PATCHREADER_LIBFUZZER
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+  parsePatch(data, size);
+  return 0;
+}
+#else
+
+static int fuzz(long iterations, unsigned seed)
+{
+  std::mt19937 rng(seed);
+  for (long i = 0; i < iterations; i++)
+  {
+    Parsed expect, got;
+    std::string line = samplePatch(rng, 1 + (i & 1), expect);
+    parsePatch((const uint8_t *)line.data(), line.size(), &got);
+    check(got, expect);
+    mutate(line, rng);
+    parsePatch((const uint8_t *)line.data(), line.size());
+  }
+  printf("fuzz: %ld inputs, seed %u, no faults\n", iterations, seed);
+  return 0;
+}
+
+static int bench(long patches)
+{
+  std::mt19937 rng(1);
+  std::vector<std::string> lines;
+  Parsed expect;
+  for (int i = 0; i < 64; i++) lines.push_back(samplePatch(rng, 1 + (i & 1), expect));
+
+  long sum = 0;
+  size_t bytes = 0;
+  auto start = std::chrono::steady_clock::now();
+  for (long i = 0; i < patches; i++)
+  {
+    const std::string &line = lines[i & 63];
+    sum += parsePatch((const uint8_t *)line.data(), line.size());
+    bytes += line.size();
+  }
+  double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  printf("bench: %ld patches, %.0f ns per patch, %.1f MB/s (checksum %ld)\n",
+         patches, seconds * 1e9 / patches, bytes / seconds / 1e6, sum);
+  return 0;
+}
+
+static int parseFile(const char *path)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    perror(path);
+    return 1;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0) data.insert(data.end(), buf, buf + n);
+  fclose(f);
+  printf("%s: checksum %ld\n", path, parsePatch(data.data(), data.size()));
+  return 0;
+}
+
+int main(int argc, char **argv)
+{
+  if (argc >= 2 && strcmp(argv[1], "fuzz") == 0)
+  {
+    return fuzz(argc > 2 ? atol(argv[2]) : 100000, argc > 3 ? (unsigned)atol(argv[3]) : 1);
+  }
+  if (argc >= 2 && strcmp(argv[1], "bench") == 0)
+  {
+    return bench(argc > 2 ? atol(argv[2]) : 200000);
+  }
+  if (argc < 2)
+  {
+    fprintf(stderr, "usage: %s fuzz [ITERATIONS] [SEED] | bench [PATCHES] | FILE...\n", argv[0]);
+    return 2;
+  }
+  int status = 0;
+  for (int i = 1; i < argc; i++) status |= parseFile(argv[i]);
+  return status;
+}
+#endif
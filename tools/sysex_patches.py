@@ -0,0 +1,148 @@
+#!/usr/bin/env python3
+"""Back up and restore Source patches over MIDI SysEx.
+
+Needs mido and python-rtmidi (pip install mido python-rtmidi).
+
+  sysex_patches.py ports
+  sysex_patches.py backup  PORT DIR          every patch into DIR/1, DIR/2 ...
+  sysex_patches.py get     PORT NUMBER FILE  one patch
+  sysex_patches.py restore PORT DIR          every numbered file in DIR
+  sysex_patches.py put     PORT FILE NUMBER  one patch
+
+Files are the same CSV the synth keeps on its SD card. See SysexDump.h in the
+firmware for the protocol.
+"""
+
+import os
+import sys
+import time
+
+import mido
+
+HEADER = [0x7D, ord('S')]
+REQ_PATCH, REQ_BANK, DATA, ACK, NAK, BANK_END = 0x01, 0x02, 0x10, 0x11, 0x12, 0x13
+CHUNK = 96
+TIMEOUT = 2.0
+
+
+def n14(value):
+    return [(value >> 7) & 0x7F, value & 0x7F]
+
+
+def v14(data, i):
+    return (data[i] << 7) | data[i + 1]
+
+
+def pack(raw):
+    out = []
+    for i in range(0, len(raw), 7):
+        block = raw[i:i + 7]
+        out.append(sum(1 << j for j, b in enumerate(block) if b & 0x80))
+        out.extend(b & 0x7F for b in block)
+    return out
+
+
+def unpack(data):
+    out = bytearray()
+    for i in range(0, len(data), 8):
+        msbs = data[i]
+        for j, b in enumerate(data[i + 1:i + 8]):
+            out.append(b | (((msbs >> j) & 1) << 7))
+    return bytes(out)
+
+
+def send(port, cmd, body=()):
+    port.send(mido.Message('sysex', data=HEADER + [cmd] + list(body)))
+
+
+def receive(port, timeout=TIMEOUT):
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        msg = port.receive(block=False)
+        if msg is None:
+            time.sleep(0.0005)
+        elif msg.type == 'sysex' and list(msg.data[:2]) == HEADER:
+            return msg.data[2], list(msg.data[3:])
+    raise TimeoutError('no reply from the synth')
+
+
+def download(inport, outport, request, body, directory=None, target=None):
+    """Receives DATA chunks until one patch (target) or BANK_END (directory)."""
+    send(outport, request, body)
+    files = {}
+    count = 0
+    while True:
+        cmd, data = receive(inport)
+        if cmd == NAK:
+            raise RuntimeError('synth refused, reason %d' % data[2])
+        if cmd == BANK_END:
+            return v14(data, 0)
+        if cmd != DATA:
+            continue
+        number, chunk, last = v14(data, 0), v14(data, 2), data[4] & 1
+        if chunk == 0:
+            files[number] = bytearray()
+        files[number] += unpack(data[5:])
+        send(outport, ACK, n14(number) + n14(chunk))
+        if last:
+            path = target or os.path.join(directory, str(number))
+            with open(path, 'wb') as f:
+                f.write(files.pop(number))
+            count += 1
+            print('\rpatch %d' % number, end='', flush=True)
+            if target:
+                print()
+                return count
+
+
+def upload(inport, outport, number, raw):
+    chunks = [raw[i:i + CHUNK] for i in range(0, len(raw), CHUNK)] or [b'']
+    for chunk, part in enumerate(chunks):
+        last = 1 if chunk == len(chunks) - 1 else 0
+        body = n14(number) + n14(chunk) + [last] + pack(part)
+        for _ in range(3):
+            send(outport, DATA, body)
+            try:
+                cmd, data = receive(inport)
+            except TimeoutError:
+                continue
+            if cmd == NAK:
+                raise RuntimeError('synth refused patch %d, reason %d' % (number, data[2]))
+            if cmd == ACK and v14(data, 0) == number and v14(data, 2) == chunk:
+                break
+        else:
+            raise TimeoutError('patch %d chunk %d not acknowledged' % (number, chunk))
+    print('\rpatch %d' % number, end='', flush=True)
+
+
+def main(argv):
+    if len(argv) < 2 or argv[1] == 'ports':
+        print('\n'.join(mido.get_output_names()))
+        return
+    command, name = argv[1], argv[2]
+    start = time.monotonic()
+    with mido.open_input(name) as inport, mido.open_output(name) as outport:
+        if command == 'backup':
+            os.makedirs(argv[3], exist_ok=True)
+            count = download(inport, outport, REQ_BANK, (), directory=argv[3])
+        elif command == 'get':
+            count = download(inport, outport, REQ_PATCH, n14(int(argv[3])), target=argv[4])
+        elif command == 'restore':
+            numbers = sorted(int(f) for f in os.listdir(argv[3]) if f.isdigit())
+            for number in numbers:
+                with open(os.path.join(argv[3], str(number)), 'rb') as f:
+                    upload(inport, outport, number, f.read())
+            send(outport, BANK_END, n14(len(numbers)))
+            count = len(numbers)
+        elif command == 'put':
+            with open(argv[3], 'rb') as f:
+                upload(inport, outport, int(argv[4]), f.read())
+            send(outport, BANK_END, n14(1))
+            count = 1
+        else:
+            sys.exit(__doc__)
+    print('\n%d patches in %.1fs' % (count, time.monotonic() - start))
+
+
+if __name__ == '__main__':
+    main(sys.argv)
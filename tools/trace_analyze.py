@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Read the firmware's event trace and print latencies.
+
+Build the firmware with TRACE_ENABLED defined in Trace.h. Capturing needs
+pyserial (pip install pyserial).
+
+  trace_analyze.py capture SERIALPORT FILE   send 'T', save the dump to FILE
+  trace_analyze.py FILE                      latencies from a saved dump
+  trace_analyze.py FILE --events             every event as well
+
+Latencies are shown in microseconds as min / median / 99th percentile / max
+with the count, for each MIDI port:
+
+  MIDI in -> note on     handler entry to the voice taking the note
+  note on -> note DAC    the pitch CV written
+  note DAC -> gate       the gate opening
+  MIDI in -> gate        the whole path
+  patch start -> end     loading a patch to its last output write
+
+See Trace.h in the firmware for the dump format.
+"""
+
+import struct
+import sys
+import time
+
+EVENTS = ['MIDI in', 'note on', 'note DAC', 'gate', 'trig', 'demux', 'patch start', 'patch end']
+MIDI_IN, NOTE_ON, NOTE_DAC, GATE, TRIG, DEMUX, PATCH_START, PATCH_END = range(len(EVENTS))
+PORTS = ['DIN', 'USB', 'host']
+
+
+def capture(port_name, path):
+    import serial
+    with serial.Serial(port_name, timeout=2) as port:
+        port.reset_input_buffer()
+        port.write(b'T')
+        magic = b''
+        while magic != b'TRC1':  # Skip anything the sketch printed first
+            byte = port.read(1)
+            if not byte:
+                raise TimeoutError('no trace from %s, is TRACE_ENABLED defined?' % port_name)
+            magic = (magic + byte)[-4:]
+        header = port.read(8)
+        count = struct.unpack('<II', header)[1]
+        records = port.read(count * 8)
+        if len(records) != count * 8:
+            raise TimeoutError('trace cut short, %d of %d events' % (len(records) // 8, count))
+    with open(path, 'wb') as f:
+        f.write(magic + header + records)
+    print('%d events saved to %s' % (count, path))
+
+
+def load(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+    if data[:4] != b'TRC1':
+        raise ValueError('%s is not a trace dump' % path)
+    cpu, count = struct.unpack_from('<II', data, 4)
+    events = [struct.unpack_from('<IBBH', data, 12 + i * 8) for i in range(count)]
+    return cpu, events
+
+
+def describe(event, arg, value):
+    if event == MIDI_IN:
+        return '%s status %02X data %d' % (PORTS[arg] if arg < len(PORTS) else arg, value >> 8, value & 0xFF)
+    if event in (NOTE_ON, NOTE_DAC):
+        return 'note %d value %d' % (arg, value)
+    if event in (GATE, TRIG):
+        return 'level %d' % arg
+    if event == DEMUX:
+        return 'channel %d' % arg
+    return 'patch %d' % value
+
+
+def summary(name, values):
+    if not values:
+        return '  %-26s -' % name
+    values = sorted(values)
+    pick = lambda q: values[min(len(values) - 1, int(q * len(values)))]
+    return '  %-26s %8.1f %8.1f %8.1f %8.1f  (%d)' % (name, values[0], pick(0.5), pick(0.99), values[-1], len(values))
+
+
+def analyze(cpu, events, show_events):
+    us = lambda start, end: ((end - start) & 0xFFFFFFFF) * 1e6 / cpu
+    latency = {}
+
+    def add(name, value):
+        latency.setdefault(name, []).append(value)
+
+    # Each note is followed from its MIDI message to the gate, a new
+    # message of the same kind starts over
+    midi_in = None  # (cycles, port) of the last note on message
+    note_on = None
+    note_dac = None
+    patch_start = None
+    first = events[0][0] if events else 0
+    for cycles, event, arg, value in events:
+        if show_events:
+            print('%12.1f  %-12s %s' % (us(first, cycles), EVENTS[event] if event < len(EVENTS) else event,
+                                        describe(event, arg, value)))
+        if event == MIDI_IN:
+            midi_in = (cycles, arg) if (value >> 12) == 0x9 else None
+        elif event == NOTE_ON:
+            note_on = cycles
+            note_dac = None
+            if midi_in:
+                add('%s MIDI in -> note on' % PORTS[midi_in[1]], us(midi_in[0], cycles))
+        elif event == NOTE_DAC and note_on is not None:
+            note_dac = cycles
+            add('note on -> note DAC', us(note_on, cycles))
+        elif event == GATE and arg and note_dac is not None:
+            add('note DAC -> gate', us(note_dac, cycles))
+            if midi_in:
+                add('%s MIDI in -> gate' % PORTS[midi_in[1]], us(midi_in[0], cycles))
+            midi_in = note_on = note_dac = None
+        elif event == PATCH_START:
+            patch_start = cycles
+        elif event == PATCH_END and patch_start is not None:
+            add('patch start -> end', us(patch_start, cycles))
+            patch_start = None
+
+    span = us(first, events[-1][0]) / 1e6 if events else 0
+    print('%d events over %.2fs at %d MHz' % (len(events), span, cpu // 1000000))
+    print('  %-26s %8s %8s %8s %8s' % ('us', 'min', 'median', '99%', 'max'))
+    for name in sorted(latency):
+        print(summary(name, latency[name]))
+
+
+def main(argv):
+    if len(argv) == 4 and argv[1] == 'capture':
+        capture(argv[2], argv[3])
+    elif len(argv) >= 2 and argv[1] != 'capture':
+        cpu, events = load(argv[1])
+        analyze(cpu, events, '--events' in argv[2:])
+    else:
+        sys.exit(__doc__)
+
+
+if __name__ == '__main__':
+    main(sys.argv)